@@ -0,0 +1,353 @@
+#include "benchmark.h"
+#include "../src/array.h"
+#include "../src/sparse.h"
+#include "../src/sparseArray.h"
+#include "../src/interpolate.h"
+#include "../src/laplace.h"
+#include "../src/simd.h"
+#include "../src/aligned.h"
+#include <cstdlib>
+
+namespace
+{
+
+template<typename T_ARRAY>
+void fill(T_ARRAY & a, int seed)
+{
+    srand(seed);
+    for (int i = 0; i < a.nx(); ++i) {
+        for (int j = 0; j < a.ny(); ++j) {
+            a(i,j) = rand() / static_cast<float>(RAND_MAX) - 0.5f;
+        }
+    }
+}
+
+// 5-point Laplacian on the full domain
+void fillLaplace(SparseLaplacianMatrix<float> & A, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            A.value<CENTER>(i,j) = 4;
+            if (i < n - 1) {
+                A.value<RIGHT>(i,j) = -1;
+            }
+            if (j < n - 1) {
+                A.value<TOP>(i,j) = -1;
+            }
+        }
+    }
+}
+
+// y = 4x minus the neighbours, rows outer like the sweeps
+template<typename T_ARRAY>
+void laplaceRows(const T_ARRAY & x, T_ARRAY & y)
+{
+    const int n = x.nx();
+    for (int j = 1; j < n - 1; ++j) {
+        for (int i = 1; i < n - 1; ++i) {
+            y(i,j) = 4 * x(i,j) - x(i-1,j) - x(i+1,j) - x(i,j-1) - x(i,j+1);
+        }
+    }
+}
+
+// The same stencil, tile by tile in storage order
+template<typename T_ARRAY>
+void laplaceTiles(const T_ARRAY & x, T_ARRAY & y)
+{
+    const size_t n = x.nx();
+    x.forEach([&](size_t i, size_t j) {
+        if (i > 0 && j > 0 && i < n - 1 && j < n - 1) {
+            y(i,j) = 4 * x(i,j) - x(i-1,j) - x(i+1,j) - x(i,j-1) - x(i,j+1);
+        }
+    });
+}
+
+// The whole-array kernels at a capped instruction set, every cell is fluid
+void benchMultLaplace(BenchmarkState & state, SimdLevel level)
+{
+    const int n = state.size();
+    SparseLaplacianMatrix<float> A(n,n,1.0f/n);
+    fillLaplace(A, n);
+    Array2f x(n,n,1.0f/n), y(n,n,1.0f/n), mask(n,n,1.0f/n);
+    fill(x, 1);
+    mask.set(-1.0f);
+    setMaxSimdLevel(level);
+    while (state.keepRunning()) {
+        multLaplace(A, x, mask, y);
+    }
+    setMaxSimdLevel(SIMD_AVX512);
+    state.setItemsProcessed(n * n);
+}
+
+// One red-black Gauss-Seidel iteration
+void benchRelaxLaplace(BenchmarkState & state, SimdLevel level)
+{
+    const int n = state.size();
+    SparseLaplacianMatrix<float> A(n,n,1.0f/n);
+    fillLaplace(A, n);
+    Array2f b(n,n,1.0f/n), p(n,n,1.0f/n), mask(n,n,1.0f/n);
+    fill(b, 1);
+    mask.set(-1.0f);
+    setMaxSimdLevel(level);
+    while (state.keepRunning()) {
+        relaxLaplace(A, b, mask, p, p, 0);
+        relaxLaplace(A, b, mask, p, p, 1);
+    }
+    setMaxSimdLevel(SIMD_AVX512);
+    state.setItemsProcessed(n * n);
+}
+
+template<typename T_ARRAY>
+void benchLaplace(BenchmarkState & state, bool tiles)
+{
+    const int n = state.size();
+    T_ARRAY x(n,n,1.0f/n), y(n,n,1.0f/n);
+    fill(x, 1);
+    while (state.keepRunning()) {
+        if (tiles) {
+            laplaceTiles(x, y);
+        } else {
+            laplaceRows(x, y);
+        }
+    }
+    state.setItemsProcessed(n * n);
+}
+
+// Particle to grid transfer, four weights per particle as in Grid
+template<typename T_FACE_ARRAY>
+void benchSplat(BenchmarkState & state)
+{
+    const int n = state.size();
+    T_FACE_ARRAY u(n,n,1.0f/n), sum(n,n,1.0f/n);
+    srand(1);
+    std::vector<Vec2f> pos(4 * n * n);
+    for (size_t k = 0; k < pos.size(); ++k) {
+        pos[k] = Vec2f(rand() / static_cast<float>(RAND_MAX),
+                       rand() / static_cast<float>(RAND_MAX));
+    }
+    while (state.keepRunning()) {
+        for (size_t k = 0; k < pos.size(); ++k) {
+            size_t i, j;
+            float tx, ty;
+            u.bary(pos[k].x, pos[k].y, i, j, tx, ty);
+            u(i,j) += (1 - tx) * (1 - ty);
+            u(i+1,j) += tx * (1 - ty);
+            u(i,j+1) += (1 - tx) * ty;
+            u(i+1,j+1) += tx * ty;
+            sum(i,j) += 1;
+        }
+    }
+    state.setItemsProcessed(pos.size());
+}
+
+}
+
+void BM_ArrayDot(BenchmarkState & state)
+{
+    const int n = state.size();
+    Array2f a(n,n,1.0f/n), b(n,n,1.0f/n);
+    fill(a, 1);
+    fill(b, 2);
+    float sum = 0;
+    while (state.keepRunning()) {
+        sum += a.dot(b);
+    }
+    state.setItemsProcessed(n * n);
+    state.setCounter("result", sum);
+}
+BENCHMARK(BM_ArrayDot)->range(64, 2048);
+
+void BM_ArrayAdd(BenchmarkState & state)
+{
+    const int n = state.size();
+    Array2f a(n,n,1.0f/n), b(n,n,1.0f/n);
+    fill(a, 1);
+    fill(b, 2);
+    while (state.keepRunning()) {
+        a.add(b, 1e-6f);
+    }
+    state.setItemsProcessed(n * n);
+}
+BENCHMARK(BM_ArrayAdd)->range(64, 2048);
+
+void BM_ArrayScaleAndAdd(BenchmarkState & state)
+{
+    const int n = state.size();
+    Array2f a(n,n,1.0f/n), b(n,n,1.0f/n);
+    fill(a, 1);
+    fill(b, 2);
+    while (state.keepRunning()) {
+        a.scaleAndAdd(0.5f, b);
+    }
+    state.setItemsProcessed(n * n);
+}
+BENCHMARK(BM_ArrayScaleAndAdd)->range(64, 2048);
+
+void BM_ArrayInfNorm(BenchmarkState & state)
+{
+    const int n = state.size();
+    Array2f a(n,n,1.0f/n);
+    fill(a, 1);
+    float norm = 0;
+    while (state.keepRunning()) {
+        norm += a.infNorm();
+    }
+    state.setItemsProcessed(n * n);
+    state.setCounter("result", norm);
+}
+BENCHMARK(BM_ArrayInfNorm)->range(64, 2048);
+
+void BM_FaceBilerp(BenchmarkState & state)
+{
+    const int n = state.size();
+    FaceArray2Xf u(n,n,1.0f/n);
+    fill(u, 1);
+    std::vector<Vec2f> pos(n * n);
+    for (size_t k = 0; k < pos.size(); ++k) {
+        pos[k] = Vec2f(rand() / static_cast<float>(RAND_MAX),
+                       rand() / static_cast<float>(RAND_MAX));
+    }
+    float sum = 0;
+    while (state.keepRunning()) {
+        for (size_t k = 0; k < pos.size(); ++k) {
+            sum += u.bilerp(pos[k]);
+        }
+    }
+    state.setItemsProcessed(pos.size());
+    state.setCounter("result", sum);
+}
+BENCHMARK(BM_FaceBilerp)->range(64, 2048);
+
+void BM_FaceBilerpBatch(BenchmarkState & state)
+{
+    const int n = state.size();
+    FaceArray2Xf u(n,n,1.0f/n);
+    fill(u, 1);
+    AlignedVectorf x(n * n), y(n * n), out(n * n);
+    for (size_t k = 0; k < x.size(); ++k) {
+        x[k] = rand() / static_cast<float>(RAND_MAX);
+        y[k] = rand() / static_cast<float>(RAND_MAX);
+    }
+    while (state.keepRunning()) {
+        bilerp(u, &x[0], &y[0], &out[0], x.size());
+    }
+    state.setItemsProcessed(x.size());
+}
+BENCHMARK(BM_FaceBilerpBatch)->range(64, 2048);
+
+// Bilerp on a face array with water in the bottom eighth of the domain
+void BM_SparseFaceBilerp(BenchmarkState & state)
+{
+    const int n = state.size();
+    SparseFaceArray2Xf u(n,n,1.0f/n);
+    for (int i = 0; i <= n; ++i) {
+        for (int j = 0; j < n / 8; ++j) {
+            u(i,j) = rand() / static_cast<float>(RAND_MAX) - 0.5f;
+        }
+    }
+    std::vector<Vec2f> pos(n * n / 8);
+    for (size_t k = 0; k < pos.size(); ++k) {
+        pos[k] = Vec2f(rand() / static_cast<float>(RAND_MAX),
+                       rand() / static_cast<float>(RAND_MAX) / 8);
+    }
+    float sum = 0;
+    int iterations = 0;
+    while (state.keepRunning()) {
+        for (size_t k = 0; k < pos.size(); ++k) {
+            sum += u.bilerp(pos[k]);
+        }
+        ++iterations;
+    }
+    // Counters are reported per iteration
+    const double MB = 1 << 20;
+    state.setItemsProcessed(pos.size());
+    state.setCounter("result", sum);
+    state.setCounter("denseMB",
+                     iterations * (n + 1.0) * n * sizeof(float) / MB);
+    state.setCounter("sparseMB", iterations * u.memory() / MB);
+}
+BENCHMARK(BM_SparseFaceBilerp)->range(64, 2048);
+
+void BM_SparseMult(BenchmarkState & state)
+{
+    const int n = state.size();
+    SparseLaplacianMatrix<float> A(n,n,1.0f/n);
+    fillLaplace(A, n);
+    Array2f x(n,n,1.0f/n), y(n,n,1.0f/n);
+    fill(x, 1);
+    while (state.keepRunning()) {
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                y(i,j) = A.mult(x,i,j);
+            }
+        }
+    }
+    state.setItemsProcessed(n * n);
+}
+BENCHMARK(BM_SparseMult)->range(64, 2048);
+
+void BM_MultLaplaceScalar(BenchmarkState & state)
+{
+    benchMultLaplace(state, SIMD_SCALAR);
+}
+BENCHMARK(BM_MultLaplaceScalar)->range(64, 2048);
+
+void BM_MultLaplaceAVX2(BenchmarkState & state)
+{
+    benchMultLaplace(state, SIMD_AVX2);
+}
+BENCHMARK(BM_MultLaplaceAVX2)->range(64, 2048);
+
+void BM_MultLaplaceAVX512(BenchmarkState & state)
+{
+    benchMultLaplace(state, SIMD_AVX512);
+}
+BENCHMARK(BM_MultLaplaceAVX512)->range(64, 2048);
+
+void BM_RelaxLaplaceScalar(BenchmarkState & state)
+{
+    benchRelaxLaplace(state, SIMD_SCALAR);
+}
+BENCHMARK(BM_RelaxLaplaceScalar)->range(64, 2048);
+
+void BM_RelaxLaplaceAVX2(BenchmarkState & state)
+{
+    benchRelaxLaplace(state, SIMD_AVX2);
+}
+BENCHMARK(BM_RelaxLaplaceAVX2)->range(64, 2048);
+
+void BM_RelaxLaplaceAVX512(BenchmarkState & state)
+{
+    benchRelaxLaplace(state, SIMD_AVX512);
+}
+BENCHMARK(BM_RelaxLaplaceAVX512)->range(64, 2048);
+
+void BM_LaplaceRows(BenchmarkState & state)
+{
+    benchLaplace<Array2f>(state, false);
+}
+BENCHMARK(BM_LaplaceRows)->range(64, 2048);
+
+void BM_LaplaceRowsTiled(BenchmarkState & state)
+{
+    benchLaplace<TiledArray2f>(state, false);
+}
+BENCHMARK(BM_LaplaceRowsTiled)->range(64, 2048);
+
+void BM_LaplaceTilesTiled(BenchmarkState & state)
+{
+    benchLaplace<TiledArray2f>(state, true);
+}
+BENCHMARK(BM_LaplaceTilesTiled)->range(64, 2048);
+
+void BM_Splat(BenchmarkState & state)
+{
+    benchSplat<FaceArray2Xf>(state);
+}
+BENCHMARK(BM_Splat)->range(64, 2048);
+
+void BM_SplatTiled(BenchmarkState & state)
+{
+    benchSplat<TiledFaceArray2Xf>(state);
+}
+BENCHMARK(BM_SplatTiled)->range(64, 2048);
@@ -0,0 +1,281 @@
+#include "benchmark.h"
+#include "../src/flip2D.h"
+#include "../src/log.h"
+#include "../src/pcg.h"
+#include "../src/compactPCG.h"
+#include "../src/mgpcg.h"
+#include "../src/multigrid.h"
+#include "../src/gaussSeidel.h"
+#include "../src/jacobi.h"
+
+namespace
+{
+
+// The box test scene at n x n, with access to the simulation stages
+class Scene : public FLIP2D
+{
+  public:
+    static Settings::Ptr settings(int n)
+    {
+        Settings::Ptr s = Settings::create();
+        s->nx = n;
+        s->ny = n;
+        s->dx = 1.0 / (n + 1.0);
+        s->solidWidth = 3.0f;
+        s->initialFluidCenter = Vec2f(0.5,0.25);
+        s->initialFluidRadius = 0.33;
+        s->initialVelocity = Vec2f(0,0);
+        s->particlesPerCell = 4;
+        s->R = 1.0 * s->dx;
+        s->r = 0.6 * s->dx;
+        s->numPhiSweepIterations = 2;
+        s->useParallelReconstruction = true;
+        s->gravity = Vec2f(0.0f, -0.82f);
+        s->numVelSweepIterations = 4;
+        s->useParallelSampling = true;
+        s->usePCG = true;
+        s->tolerance = 1e-5;
+        s->maxIterations = 1000;
+        s->useMultigrid = false;
+        s->numFullCycles = 1;
+        s->numVCycles = 2;
+        s->numPreSweeps = 2;
+        s->numPostSweeps = 2;
+        s->nxMin = 16;
+        s->useGaussSeidel = false;
+        s->numGaussSeidelIterations = 50;
+        s->useJacobi = false;
+        s->numJacobiIterations = 100;
+        return s;
+    }
+
+    Scene(Settings::Ptr s) : FLIP2D(s)
+    {
+        // Run the stages once so every field is in a steady state
+        _grid->sampleVelocities(_particles);
+        _fluid->reconstructSurface(_particles, s->R, s->r);
+        _fluid->reinitialize(s->numPhiSweepIterations);
+        _fluid->extrapolateIntoSolid(_solid);
+        _grid->applyGravity(s->gravity, dt());
+        _grid->extrapolateVelocities(_fluid, s->numVelSweepIterations);
+    }
+
+    float dt() const { return 1.0f / 24.0f; }
+
+    void sampleVelocities() { _grid->sampleVelocities(_particles); }
+
+    void reconstructSurface()
+    {
+        _fluid->reconstructSurface(_particles, _settings->R, _settings->r);
+    }
+
+    void reinitialize()
+    {
+        _fluid->reinitialize(_settings->numPhiSweepIterations);
+    }
+
+    void extrapolateVelocities()
+    {
+        _grid->extrapolateVelocities(_fluid, _settings->numVelSweepIterations);
+    }
+
+    void buildPressure(PressureSolver & solver)
+    {
+        solver.buildLinearSystem(_grid, _solid, _fluid, dt());
+    }
+
+    void solvePressure(PressureSolver & solver)
+    {
+        solver.solveLinearSystem(_fluid, dt());
+    }
+
+    int numParticles() const { return _particles->numParticles(); }
+
+    int numCells() const { return _settings->nx * _settings->ny; }
+};
+
+void quiet()
+{
+    Log::instance().setLevel(FLIP2D_LOG_ERROR);
+}
+
+void solve(BenchmarkState & state, Settings::Ptr s, PressureSolver::Ptr p)
+{
+    Scene scene(s);
+    int iterations = 0;
+    while (state.keepRunning()) {
+        // The solvers overwrite the right hand side, rebuild untimed
+        state.pauseTiming();
+        scene.buildPressure(*p.ptr());
+        state.resumeTiming();
+        scene.solvePressure(*p.ptr());
+        iterations += p->solveIterations();
+    }
+    state.setItemsProcessed(scene.numCells());
+    state.setCounter("solverIterations", iterations);
+}
+
+}
+
+void BM_SampleVelocities(BenchmarkState & state)
+{
+    quiet();
+    Scene scene(Scene::settings(state.size()));
+    while (state.keepRunning()) {
+        scene.sampleVelocities();
+    }
+    state.setItemsProcessed(scene.numParticles());
+}
+BENCHMARK(BM_SampleVelocities)->range(64, 2048);
+
+void BM_ReconstructSurface(BenchmarkState & state)
+{
+    quiet();
+    Scene scene(Scene::settings(state.size()));
+    while (state.keepRunning()) {
+        scene.reconstructSurface();
+    }
+    state.setItemsProcessed(scene.numParticles());
+}
+BENCHMARK(BM_ReconstructSurface)->range(64, 2048);
+
+void BM_Reinitialize(BenchmarkState & state)
+{
+    quiet();
+    Scene scene(Scene::settings(state.size()));
+    while (state.keepRunning()) {
+        scene.reinitialize();
+    }
+    state.setItemsProcessed(scene.numCells());
+}
+BENCHMARK(BM_Reinitialize)->range(64, 2048);
+
+void BM_ReinitializeNarrowBand(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    s->useNarrowBand = true;
+    Scene scene(s);
+    while (state.keepRunning()) {
+        scene.reinitialize();
+    }
+    state.setItemsProcessed(scene.numCells());
+}
+BENCHMARK(BM_ReinitializeNarrowBand)->range(64, 2048);
+
+void BM_ExtrapolateVelocities(BenchmarkState & state)
+{
+    quiet();
+    Scene scene(Scene::settings(state.size()));
+    while (state.keepRunning()) {
+        scene.extrapolateVelocities();
+    }
+    state.setItemsProcessed(scene.numCells());
+}
+BENCHMARK(BM_ExtrapolateVelocities)->range(64, 2048);
+
+void BM_ExtrapolateVelocitiesBand(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    s->useBandExtrapolation = true;
+    Scene scene(s);
+    while (state.keepRunning()) {
+        scene.extrapolateVelocities();
+    }
+    state.setItemsProcessed(scene.numCells());
+}
+BENCHMARK(BM_ExtrapolateVelocitiesBand)->range(64, 2048);
+
+void BM_BuildPressure(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    Scene scene(s);
+    PressureSolver::Ptr p = PCG::create(s);
+    while (state.keepRunning()) {
+        scene.buildPressure(*p.ptr());
+    }
+    state.setItemsProcessed(scene.numCells());
+}
+BENCHMARK(BM_BuildPressure)->range(64, 2048);
+
+void BM_SolvePCG(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, PCG::create(s));
+}
+BENCHMARK(BM_SolvePCG)->range(64, 2048);
+
+void BM_SolvePCGWavefront(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    s->preconditioner = Settings::MIC_WAVEFRONT;
+    solve(state, s, PCG::create(s));
+}
+BENCHMARK(BM_SolvePCGWavefront)->range(64, 2048);
+
+void BM_SolvePCGRedBlack(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    s->preconditioner = Settings::IC_RED_BLACK;
+    solve(state, s, PCG::create(s));
+}
+BENCHMARK(BM_SolvePCGRedBlack)->range(64, 2048);
+
+void BM_SolveCompactPCG(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, CompactPCG::create(s));
+}
+BENCHMARK(BM_SolveCompactPCG)->range(64, 2048);
+
+void BM_SolveMGPCG(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, MGPCG::create(s));
+}
+BENCHMARK(BM_SolveMGPCG)->range(64, 2048);
+
+void BM_SolveMultigrid(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, Multigrid::create(s));
+}
+BENCHMARK(BM_SolveMultigrid)->range(64, 2048);
+
+void BM_SolveGaussSeidel(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, GaussSeidel::create(s));
+}
+BENCHMARK(BM_SolveGaussSeidel)->range(64, 2048);
+
+void BM_SolveJacobi(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    solve(state, s, Jacobi::create(s));
+}
+BENCHMARK(BM_SolveJacobi)->range(64, 2048);
+
+void BM_Step(BenchmarkState & state)
+{
+    quiet();
+    Settings::Ptr s = Scene::settings(state.size());
+    FLIP2D::Ptr flip = FLIP2D::create(s);
+    int substeps = 0;
+    while (state.keepRunning()) {
+        substeps += flip->step(1.0f / 24.0f).numSubsteps;
+    }
+    state.setItemsProcessed(s->nx * s->ny);
+    state.setCounter("substeps", substeps);
+}
+BENCHMARK(BM_Step)->range(64, 2048);
@@ -0,0 +1,261 @@
+#include "benchmark.h"
+#include "../src/parallel.h"
+#include "../src/simd.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+
+namespace
+{
+
+std::vector<Benchmark *> & registry()
+{
+    static std::vector<Benchmark *> benchmarks;
+    return benchmarks;
+}
+
+struct Result
+{
+    std::string name;
+    int size;
+    long iterations;
+    double time;        // Seconds per iteration
+    double itemsPerSecond;
+    std::vector<std::pair<std::string, double> > counters;
+};
+
+const char * simdName(SimdLevel level)
+{
+    switch (level) {
+        case SIMD_AVX512: return "avx512";
+        case SIMD_AVX2:   return "avx2";
+        default:          return "scalar";
+    }
+}
+
+bool optimized()
+{
+#ifdef __OPTIMIZE__
+    return true;
+#else
+    return false;
+#endif
+}
+
+Result run(const Benchmark & b, int size, double minTime)
+{
+    long iterations = 1;
+    for (;;) {
+        BenchmarkState state(size, iterations);
+        b.function()(state);
+        const double t = state.elapsed();
+        if (t >= minTime || iterations >= 1000000000L) {
+            Result r;
+            r.name = b.name();
+            r.size = size;
+            r.iterations = iterations;
+            r.time = t / iterations;
+            r.itemsPerSecond = state.itemsProcessed() > 0 && t > 0 ?
+                    state.itemsProcessed() * iterations / t : 0;
+            r.counters = state.counters();
+            for (size_t i = 0; i < r.counters.size(); ++i) {
+                r.counters[i].second /= iterations;
+            }
+            return r;
+        }
+        // Grow like Google Benchmark: aim 40% past the minimum time
+        double factor = t > 0 ? 1.4 * minTime / t : 10;
+        factor = factor < 2 ? 2 : (factor > 10 ? 10 : factor);
+        iterations = static_cast<long>(iterations * factor);
+    }
+}
+
+void writeConsole(std::ostream & out, const Result & r)
+{
+    std::ostringstream name;
+    name << r.name << "/" << r.size;
+    out.width(40);
+    out << std::left << name.str();
+    out.width(14);
+    out << std::right << r.time * 1e6 << " us";
+    out.width(12);
+    out << r.iterations;
+    if (r.itemsPerSecond > 0) {
+        out << "  " << r.itemsPerSecond * 1e-6 << " M items/s";
+    }
+    for (size_t i = 0; i < r.counters.size(); ++i) {
+        out << "  " << r.counters[i].first << "=" << r.counters[i].second;
+    }
+    out << std::endl;
+}
+
+void writeCSV(std::ostream & out, const std::vector<Result> & results)
+{
+    out << "name,size,iterations,time_us,items_per_second,counters\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const Result & r = results[k];
+        out << r.name << "," << r.size << "," << r.iterations << ","
+            << r.time * 1e6 << "," << r.itemsPerSecond << ",";
+        for (size_t i = 0; i < r.counters.size(); ++i) {
+            out << (i ? ";" : "") << r.counters[i].first << "="
+                << r.counters[i].second;
+        }
+        out << "\n";
+    }
+}
+
+void writeJSON(std::ostream & out, const std::vector<Result> & results)
+{
+    char date[64];
+    const time_t now = time(0);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    out << "{\n  \"context\": {\"date\": \"" << date << "\""
+        << ", \"num_threads\": " << numThreads()
+        << ", \"simd\": \"" << simdName(simdLevel()) << "\""
+        << ", \"optimized\": " << (optimized() ? "true" : "false")
+        << "},\n  \"benchmarks\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const Result & r = results[k];
+        out << "    {\"name\": \"" << r.name << "/" << r.size << "\""
+            << ", \"size\": " << r.size
+            << ", \"iterations\": " << r.iterations
+            << ", \"time_us\": " << r.time * 1e6
+            << ", \"items_per_second\": " << r.itemsPerSecond;
+        for (size_t i = 0; i < r.counters.size(); ++i) {
+            out << ", \"" << r.counters[i].first << "\": "
+                << r.counters[i].second;
+        }
+        out << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+const char * option(const char * arg, const char * name)
+{
+    const size_t n = strlen(name);
+    return strncmp(arg, name, n) == 0 ? arg + n : 0;
+}
+
+}
+
+BenchmarkState::BenchmarkState(int size, long iterations) :
+        _size(size),
+        _iterations(iterations),
+        _remaining(iterations),
+        _started(false),
+        _elapsed(0),
+        _items(0)
+{
+}
+
+void BenchmarkState::setCounter(const std::string & name, double value)
+{
+    for (size_t i = 0; i < _counters.size(); ++i) {
+        if (_counters[i].first == name) {
+            _counters[i].second = value;
+            return;
+        }
+    }
+    _counters.push_back(std::make_pair(name, value));
+}
+
+Benchmark::Benchmark(const char * name, BenchmarkFunction function) :
+        _name(name),
+        _function(function)
+{
+}
+
+Benchmark * Benchmark::range(int lo, int hi)
+{
+    for (int n = lo; n <= hi; n *= 2) {
+        _sizes.push_back(n);
+    }
+    return this;
+}
+
+Benchmark * Benchmark::arg(int size)
+{
+    _sizes.push_back(size);
+    return this;
+}
+
+Benchmark * registerBenchmark(const char * name, BenchmarkFunction function)
+{
+    registry().push_back(new Benchmark(name, function));
+    return registry().back();
+}
+
+int runBenchmarks(int argc, char * argv[])
+{
+    std::string filter;
+    std::string format = "console";
+    std::string outFile;
+    double minTime = 0.5;
+    int maxSize = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char * v;
+        if ((v = option(argv[i], "--filter="))) {
+            filter = v;
+        } else if ((v = option(argv[i], "--format="))) {
+            format = v;
+        } else if ((v = option(argv[i], "--out="))) {
+            outFile = v;
+        } else if ((v = option(argv[i], "--min_time="))) {
+            minTime = atof(v);
+        } else if ((v = option(argv[i], "--max_size="))) {
+            maxSize = atoi(v);
+        } else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!optimized()) {
+        std::cerr << "***WARNING*** Benchmarks were built without "
+                  << "optimization, timings will be misleading." << std::endl;
+    }
+
+    std::vector<Result> results;
+    for (size_t k = 0; k < registry().size(); ++k) {
+        const Benchmark & b = *registry()[k];
+        if (b.name().find(filter) == std::string::npos) {
+            continue;
+        }
+        const std::vector<int> & sizes = b.sizes();
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            if (maxSize > 0 && sizes[i] > maxSize) {
+                continue;
+            }
+            results.push_back(run(b, sizes[i], minTime));
+            writeConsole(std::cerr, results.back());
+        }
+    }
+
+    std::ofstream file;
+    if (!outFile.empty()) {
+        file.open(outFile.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Could not open " << outFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream & out = file.is_open() ? file : std::cout;
+    if (format == "json") {
+        writeJSON(out, results);
+    } else if (format == "csv") {
+        writeCSV(out, results);
+    } else if (file.is_open()) {
+        for (size_t k = 0; k < results.size(); ++k) {
+            writeConsole(out, results[k]);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    return runBenchmarks(argc, argv);
+}
@@ -0,0 +1,121 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "../src/timer.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+    Minimal benchmark harness in the style of Google Benchmark. A benchmark
+    is a function that loops over BenchmarkState::keepRunning(). The runner
+    grows the iteration count until the timed loop takes at least the
+    minimum time, then reports the time per iteration.
+
+        void BM_foo(BenchmarkState & state)
+        {
+            Setup setup(state.size());
+            while (state.keepRunning()) {
+                foo(setup);
+            }
+            state.setItemsProcessed(state.size() * state.size());
+        }
+        BENCHMARK(BM_foo)->range(64, 2048);
+*/
+class BenchmarkState
+{
+  public:
+    BenchmarkState(int size, long iterations);
+
+    int size() const { return _size; }
+
+    long iterations() const { return _iterations; }
+
+    bool keepRunning()
+    {
+        if (!_started) {
+            _started = true;
+            _timer.reset();
+        }
+        if (_remaining > 0) {
+            --_remaining;
+            return true;
+        }
+        _elapsed += _timer.elapsed();
+        return false;
+    }
+
+    // Excludes setup code inside the loop from the timing
+    void pauseTiming() { _elapsed += _timer.elapsed(); }
+
+    void resumeTiming() { _timer.reset(); }
+
+    // Items per iteration, reported as a throughput
+    void setItemsProcessed(double items) { _items = items; }
+
+    // Reports a user value, averaged over the iterations
+    void setCounter(const std::string & name, double value);
+
+    double elapsed() const { return _elapsed; }
+
+    double itemsProcessed() const { return _items; }
+
+    const std::vector<std::pair<std::string, double> > & counters() const
+    {
+        return _counters;
+    }
+
+  protected:
+    int _size;
+    long _iterations;
+    long _remaining;
+    bool _started;
+    double _elapsed;
+    double _items;
+    Timer _timer;
+    std::vector<std::pair<std::string, double> > _counters;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState &);
+
+class Benchmark
+{
+  public:
+    Benchmark(const char * name, BenchmarkFunction function);
+
+    // Runs the benchmark for all powers of two in [lo, hi]
+    Benchmark * range(int lo, int hi);
+
+    Benchmark * arg(int size);
+
+    const std::string & name() const { return _name; }
+
+    BenchmarkFunction function() const { return _function; }
+
+    const std::vector<int> & sizes() const { return _sizes; }
+
+  protected:
+    std::string _name;
+    BenchmarkFunction _function;
+    std::vector<int> _sizes;
+};
+
+Benchmark * registerBenchmark(const char * name, BenchmarkFunction function);
+
+/**
+    Runs all registered benchmarks. Options:
+        --filter=<substring>      only run benchmarks whose name matches
+        --format=console|csv|json
+        --out=<file>              write the report to a file
+        --min_time=<seconds>      minimum timed duration (default 0.5)
+        --max_size=<n>            skip sizes above n
+*/
+int runBenchmarks(int argc, char * argv[]);
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK(f)                                                    \
+    static Benchmark * BENCHMARK_CONCAT(_benchmark_, __LINE__) =        \
+            registerBenchmark(#f, f)
+
+#endif
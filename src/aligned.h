@@ -0,0 +1,74 @@
+#ifndef ALIGNED_H_
+#define ALIGNED_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#include <malloc.h>
+#endif
+
+/**
+    Minimal allocator handing out storage aligned to T_ALIGNMENT bytes, so
+    std::vector data can be used with aligned SIMD loads.
+*/
+template<typename T, size_t T_ALIGNMENT = 64>
+class AlignedAllocator
+{
+  public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, T_ALIGNMENT> other;
+    };
+
+    AlignedAllocator() {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, T_ALIGNMENT> &) {}
+
+    T * allocate(size_t n)
+    {
+        void * p = 0;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+        p = _aligned_malloc(n * sizeof(T), T_ALIGNMENT);
+#else
+        if (posix_memalign(&p, T_ALIGNMENT, n * sizeof(T))) {
+            p = 0;
+        }
+#endif
+        if (!p && n) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T * p, size_t)
+    {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, T_ALIGNMENT> &) const
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, T_ALIGNMENT> &) const
+    {
+        return false;
+    }
+};
+
+typedef std::vector<float, AlignedAllocator<float> > AlignedVectorf;
+
+#endif
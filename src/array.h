@@ -8,8 +8,135 @@
 #include <cassert>
 #include <algorithm>
 #include <cmath>
+#include <utility>
+#include <stdint.h>
+
+/**
+    Where Array2 stores (i,j). The default is column major, j + ny * i.
+    A layout also lists its tiles, index ranges that are contiguous in
+    memory, in storage order.
+*/
+class LinearLayout
+{
+  public:
+    LinearLayout() : _nx(0), _ny(0) {}
 
-template<typename T>
+    void resize(size_t nx, size_t ny)
+    {
+        _nx = nx;
+        _ny = ny;
+    }
+
+    size_t size() const { return _nx * _ny; }
+
+    size_t index(size_t i, size_t j) const { return j + _ny * i; }
+
+    // Calls f(i0, i1, j0, j1) with half open ranges, here just once
+    template<typename F>
+    void forEachTile(F f) const
+    {
+        if (_nx && _ny) {
+            f(0, _nx, 0, _ny);
+        }
+    }
+
+  protected:
+    size_t _nx, _ny;
+};
+
+/**
+    T_TILE x T_TILE tiles, column major inside a tile, with the tiles
+    ordered along a Z-curve (Morton order). A stencil then touches a few
+    cache lines instead of a few columns, and nearby tiles are nearby in
+    memory in both directions. The tiles on the top and right edges are
+    cut to the array, so there is no padding.
+*/
+template<size_t T_TILE = 8>
+class MortonTileLayout
+{
+  public:
+    MortonTileLayout() : _nx(0), _ny(0), _ntx(0), _nty(0), _lastHeight(0) {}
+
+    void resize(size_t nx, size_t ny)
+    {
+        _nx = nx;
+        _ny = ny;
+        _ntx = (nx + T_TILE - 1) / T_TILE;
+        _nty = (ny + T_TILE - 1) / T_TILE;
+        _lastHeight = ny - (_nty ? _nty - 1 : 0) * T_TILE;
+
+        std::vector<std::pair<uint32_t, uint32_t> > codes(_ntx * _nty);
+        for (size_t ti = 0; ti < _ntx; ++ti) {
+            for (size_t tj = 0; tj < _nty; ++tj) {
+                const uint32_t t = tj + _nty * ti;
+                codes[t] = std::make_pair(_spread(ti) | (_spread(tj) << 1), t);
+            }
+        }
+        std::sort(codes.begin(), codes.end());
+        _order.resize(codes.size());
+        _offset.resize(codes.size());
+        size_t offset = 0;
+        for (size_t k = 0; k < codes.size(); ++k) {
+            const uint32_t t = codes[k].second;
+            _order[k] = t;
+            _offset[t] = offset;
+            offset += _width(t / _nty) * _height(t % _nty);
+        }
+    }
+
+    size_t size() const { return _nx * _ny; }
+
+    size_t index(size_t i, size_t j) const
+    {
+        const size_t tj = j / T_TILE;
+        const size_t h = tj + 1 < _nty ? T_TILE : _lastHeight;
+        return _offset[tj + _nty * (i / T_TILE)] + (i % T_TILE) * h +
+                j % T_TILE;
+    }
+
+    // Calls f(i0, i1, j0, j1) for every tile, in Morton order
+    template<typename F>
+    void forEachTile(F f) const
+    {
+        for (size_t k = 0; k < _order.size(); ++k) {
+            const size_t ti = _order[k] / _nty;
+            const size_t tj = _order[k] % _nty;
+            f(ti * T_TILE, ti * T_TILE + _width(ti),
+              tj * T_TILE, tj * T_TILE + _height(tj));
+        }
+    }
+
+  protected:
+    size_t _nx, _ny;
+    size_t _ntx, _nty;
+    size_t _lastHeight;
+    // Start of each tile (tj + nty * ti), and the tiles in storage order
+    std::vector<size_t> _offset;
+    std::vector<uint32_t> _order;
+
+    size_t _width(size_t ti) const
+    {
+        return std::min(T_TILE, _nx - ti * T_TILE);
+    }
+
+    size_t _height(size_t tj) const
+    {
+        return std::min(T_TILE, _ny - tj * T_TILE);
+    }
+
+    // Moves bit k of the lower 16 bits to bit 2k
+    static uint32_t _spread(uint32_t x)
+    {
+        x &= 0xFFFF;
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return x;
+    }
+};
+
+template<typename T, typename T_LAYOUT = LinearLayout>
 class Array2
 {
   public:
@@ -18,7 +145,8 @@ class Array2
     Array2(size_t nx, size_t ny, float dx) :
             _nx(nx), _ny(ny), _dx(dx)
     {
-        _data.resize(_nx*_ny);
+        _layout.resize(_nx, _ny);
+        _data.resize(_layout.size());
     }
 
     const T & operator()(size_t i, size_t j) const
@@ -107,10 +235,11 @@ class Array2
         _nx = nx;
         _ny = ny;
         _dx = dx;
-        _data.resize(_nx*_ny);
+        _layout.resize(_nx, _ny);
+        _data.resize(_layout.size());
     }
 
-    void copy(const Array2<T> & src)
+    void copy(const Array2 & src)
     {
         assert(src._data.size() == _data.size());
         std::copy(src._data.begin(),
@@ -118,12 +247,44 @@ class Array2
                   _data.begin());
     }
 
-    void swap(Array2<T> & src)
+    void swap(Array2 & src)
     {
         _data.swap(src._data);
     }
 
-    T dot(const Array2<T> & rhs)
+    // Binary dump of the dimensions and the values
+    void write(std::ostream & out) const
+    {
+        const int32_t dims[2] = { static_cast<int32_t>(_nx),
+                                  static_cast<int32_t>(_ny) };
+        out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+        out.write(reinterpret_cast<const char*>(&_dx), sizeof(float));
+        if (!_data.empty()) {
+            out.write(reinterpret_cast<const char*>(&_data[0]),
+                      sizeof(T) * _data.size());
+        }
+    }
+
+    // Reads a dump of an array with the same dimensions
+    bool read(std::istream & in)
+    {
+        int32_t dims[2];
+        float dx;
+        in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+        in.read(reinterpret_cast<char*>(&dx), sizeof(float));
+        if (!in.good() || dims[0] != static_cast<int32_t>(_nx) ||
+            dims[1] != static_cast<int32_t>(_ny)) {
+            return false;
+        }
+        _dx = dx;
+        if (!_data.empty()) {
+            in.read(reinterpret_cast<char*>(&_data[0]),
+                    sizeof(T) * _data.size());
+        }
+        return in.good();
+    }
+
+    T dot(const Array2 & rhs)
     {
         assert(rhs._data.size() == _data.size());
         T sum = 0;
@@ -147,21 +308,42 @@ class Array2
         }
     }
     
-    void add(const Array2<T> & rhs, T scale = 1.0)
+    void add(const Array2 & rhs, T scale = 1.0)
     {
         for (size_t i = 0; i < _data.size(); ++i) {
             _data[i] += rhs._data[i] * scale;
         }
     }
 
-    void scaleAndAdd(T scale, const Array2<T> & addArray)
+    /**
+        One conjugate gradient update in a single pass over the four
+        arrays, x += alpha * s and, for the residual in this array,
+        this -= alpha * z. Returns the infNorm of the updated residual.
+    */
+    T cgUpdate(T alpha, const Array2 & s, const Array2 & z, Array2 & x)
+    {
+        assert(s._data.size() == _data.size());
+        assert(z._data.size() == _data.size());
+        assert(x._data.size() == _data.size());
+        T norm = 0;
+        for (size_t i = 0; i < _data.size(); ++i) {
+            x._data[i] += s._data[i] * alpha;
+            _data[i] += z._data[i] * -alpha;
+            if (std::fabs(_data[i]) > norm) {
+                norm = std::fabs(_data[i]);
+            }
+        }
+        return norm;
+    }
+
+    void scaleAndAdd(T scale, const Array2 & addArray)
     {
         for (size_t i = 0; i < _data.size(); ++i) {
             _data[i] = _data[i] * scale + addArray._data[i];
         }
     }
 
-    void multiply(const Array2<T> & rhs)
+    void multiply(const Array2 & rhs)
     {
         for (size_t i = 0; i < _data.size(); ++i) {
                 _data[i] *= rhs._data[i];
@@ -175,7 +357,7 @@ class Array2
         }
     }
     
-    void divide(const Array2<T> & rhs)
+    void divide(const Array2 & rhs)
     {
         for (size_t i = 0; i < _data.size(); ++i) {
             if (rhs._data[i]) {
@@ -218,17 +400,43 @@ class Array2
     size_t nx() const { return _nx; }
     size_t ny() const { return _ny; }
     float dx() const { return _dx; }
+
+    const T * data() const { return &_data[0]; }
+    T * data() { return &_data[0]; }
+
+    const T_LAYOUT & layout() const { return _layout; }
+
+    // Calls f(i0, i1, j0, j1) for the tiles of the layout, in storage order
+    template<typename F>
+    void forEachTile(F f) const
+    {
+        _layout.forEachTile(f);
+    }
+
+    // Calls f(i,j) for every element, in storage order
+    template<typename F>
+    void forEach(F f) const
+    {
+        _layout.forEachTile([&](size_t i0, size_t i1, size_t j0, size_t j1) {
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    f(i,j);
+                }
+            }
+        });
+    }
     
   protected:
     size_t _nx, _ny;
     float _dx;
     std::vector<T> _data;
+    T_LAYOUT _layout;
 
     size_t _idx(size_t i, size_t j) const
     {
         assert(i < _nx);
         assert(j < _ny);
-        return j + _ny * i;
+        return _layout.index(i,j);
     }
 };
 
@@ -236,6 +444,8 @@ typedef Array2<float> Array2f;
 typedef Array2<double> Array2d;
 typedef Array2<char> Array2c;
 typedef Array2<int> Array2i;
+typedef Array2<float, MortonTileLayout<> > TiledArray2f;
+typedef Array2<double, MortonTileLayout<> > TiledArray2d;
 
 enum Faces
 {
@@ -246,13 +456,14 @@ enum Faces
     RIGHT = 4,
 };
 
-template <typename T, size_t T_DIMX, size_t T_DIMY>
-class FaceArray2 : public Array2<T>
+template <typename T, size_t T_DIMX, size_t T_DIMY,
+          typename T_LAYOUT = LinearLayout>
+class FaceArray2 : public Array2<T, T_LAYOUT>
 {
   public:
     FaceArray2() {}
     FaceArray2(size_t nx, size_t ny, float dx) :
-            Array2<T>(nx + T_DIMX, ny + T_DIMY, dx)
+            Array2<T, T_LAYOUT>(nx + T_DIMX, ny + T_DIMY, dx)
     {
         assert(T_DIMX || T_DIMY);
     }
@@ -357,12 +568,12 @@ class FaceArray2 : public Array2<T>
         size_t i,j;
         float tx,ty;
         bary(x, y, i, j, tx, ty);
-        return Array2<T>::bilerp(i, j, tx, ty);
+        return Array2<T, T_LAYOUT>::bilerp(i, j, tx, ty);
     }
     
     void resize(size_t nx, size_t ny, float dx = 1.0)
     {
-        Array2<T>::resize(nx + T_DIMX, ny + T_DIMY, dx);
+        Array2<T, T_LAYOUT>::resize(nx + T_DIMX, ny + T_DIMY, dx);
     }
 
     size_t nx() const { return _nx - 1 * T_DIMX; }
@@ -371,11 +582,11 @@ class FaceArray2 : public Array2<T>
   protected:
     // To make it compile in earlier gcc versions.
     // This bug is fixed in 4.7 and forward it seems
-    using Array2<T>::_data;
-    using Array2<T>::_idx;
-    using Array2<T>::_nx;
-    using Array2<T>::_ny;
-    using Array2<T>::_dx;
+    using Array2<T, T_LAYOUT>::_data;
+    using Array2<T, T_LAYOUT>::_idx;
+    using Array2<T, T_LAYOUT>::_nx;
+    using Array2<T, T_LAYOUT>::_ny;
+    using Array2<T, T_LAYOUT>::_dx;
 };
 
 typedef FaceArray2<float,1,0> FaceArray2Xf;
@@ -386,6 +597,8 @@ typedef FaceArray2<char,1,0> FaceArray2Xc;
 typedef FaceArray2<char,0,1> FaceArray2Yc;
 typedef FaceArray2<int,1,0> FaceArray2Xi;
 typedef FaceArray2<int,0,1> FaceArray2Yi;
+typedef FaceArray2<float,1,0,MortonTileLayout<> > TiledFaceArray2Xf;
+typedef FaceArray2<float,0,1,MortonTileLayout<> > TiledFaceArray2Yf;
 
 enum Corner
 {
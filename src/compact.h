@@ -0,0 +1,153 @@
+#ifndef COMPACT_H_
+#define COMPACT_H_
+
+#include "array.h"
+#include <vector>
+
+/**
+    5-point Laplacian stored only for the fluid cells. The fluid cells are
+    numbered in Array2 storage order, so the rows keep the natural ordering
+    of the full grid matrix. Every row stores its diagonal and the couplings
+    to the LEFT, RIGHT, BOTTOM and TOP neighbours together with the
+    neighbours' row indices. A neighbour outside the fluid points back at
+    the row itself with a zero coupling, so products need no tests.
+*/
+template <typename T>
+class CompactLaplacianMatrix
+{
+  public:
+    CompactLaplacianMatrix() {}
+
+    /**
+        Numbers the cells with phi < 0 and sets up the neighbour indices.
+        All coefficients are reset to zero.
+    */
+    void buildIndex(const Array2f & phi)
+    {
+        _index.resize(phi.nx(), phi.ny(), phi.dx());
+        _cellI.clear();
+        _cellJ.clear();
+        for (int i = 0; i < phi.nx(); ++i) {
+            for (int j = 0; j < phi.ny(); ++j) {
+                if (phi(i,j) < 0) {
+                    _index(i,j) = _cellI.size();
+                    _cellI.push_back(i);
+                    _cellJ.push_back(j);
+                } else {
+                    _index(i,j) = -1;
+                }
+            }
+        }
+
+        const int n = rows();
+        for (int f = CENTER; f <= RIGHT; ++f) {
+            _value[f].assign(n, 0);
+            _neighbor[f].resize(n);
+        }
+#pragma omp parallel for
+        for (int r = 0; r < n; ++r) {
+            const int i = _cellI[r];
+            const int j = _cellJ[r];
+            _neighbor[CENTER][r] = r;
+            _neighbor[LEFT][r] = _find(i - 1, j, r);
+            _neighbor[RIGHT][r] = _find(i + 1, j, r);
+            _neighbor[BOTTOM][r] = _find(i, j - 1, r);
+            _neighbor[TOP][r] = _find(i, j + 1, r);
+        }
+    }
+
+    /**
+        Sets the LEFT and BOTTOM couplings from the RIGHT and TOP couplings
+        of the neighbouring rows.
+    */
+    void symmetrize()
+    {
+        const int n = rows();
+#pragma omp parallel for
+        for (int r = 0; r < n; ++r) {
+            _value[LEFT][r] = hasNeighbor<LEFT>(r) ?
+                    _value[RIGHT][_neighbor[LEFT][r]] : 0;
+            _value[BOTTOM][r] = hasNeighbor<BOTTOM>(r) ?
+                    _value[TOP][_neighbor[BOTTOM][r]] : 0;
+        }
+    }
+
+    int rows() const { return _cellI.size(); }
+
+    // Row of cell (i,j), or -1 if the cell is not in the system
+    int row(int i, int j) const { return _index(i,j); }
+
+    int cellI(int r) const { return _cellI[r]; }
+    int cellJ(int r) const { return _cellJ[r]; }
+
+    template<int T_ELEMENT>
+    T & value(int r) { return _value[T_ELEMENT][r]; }
+
+    template<int T_ELEMENT>
+    T value(int r) const { return _value[T_ELEMENT][r]; }
+
+    template<int T_ELEMENT>
+    int neighbor(int r) const { return _neighbor[T_ELEMENT][r]; }
+
+    template<int T_ELEMENT>
+    bool hasNeighbor(int r) const { return _neighbor[T_ELEMENT][r] != r; }
+
+    // Same operation order as SparseLaplacianMatrix::mult
+    T mult(const T * x, int r) const
+    {
+        return _value[CENTER][r] * x[r] +
+               (_value[LEFT][r] * x[_neighbor[LEFT][r]] +
+                _value[RIGHT][r] * x[_neighbor[RIGHT][r]] +
+                _value[BOTTOM][r] * x[_neighbor[BOTTOM][r]] +
+                _value[TOP][r] * x[_neighbor[TOP][r]]);
+    }
+
+    void mult(const T * x, T * y) const
+    {
+        const int n = rows();
+#pragma omp parallel for
+        for (int r = 0; r < n; ++r) {
+            y[r] = mult(x, r);
+        }
+    }
+
+    void gather(const Array2<T> & src, T * dst) const
+    {
+        const int n = rows();
+#pragma omp parallel for
+        for (int r = 0; r < n; ++r) {
+            dst[r] = src(_cellI[r], _cellJ[r]);
+        }
+    }
+
+    /**
+        Writes the compact vector to the fluid cells of dst and zero
+        everywhere else.
+    */
+    void scatter(const T * src, Array2<T> & dst) const
+    {
+        dst.reset();
+        const int n = rows();
+#pragma omp parallel for
+        for (int r = 0; r < n; ++r) {
+            dst(_cellI[r], _cellJ[r]) = src[r];
+        }
+    }
+
+  protected:
+    Array2i _index;
+    std::vector<int> _cellI;
+    std::vector<int> _cellJ;
+    std::vector<T> _value[5];
+    std::vector<int> _neighbor[5];
+
+    int _find(int i, int j, int self) const
+    {
+        if (i < 0 || j < 0 || i >= _index.nx() || j >= _index.ny()) {
+            return self;
+        }
+        return _index(i,j) < 0 ? self : _index(i,j);
+    }
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "compactPCG.h"
+#include "log.h"
+#include "timer.h"
+
+namespace
+{
+
+float dot(const AlignedVectorf & a, const AlignedVectorf & b)
+{
+    float sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+float infNorm(const AlignedVectorf & a)
+{
+    float norm = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::fabs(a[i]) > norm) {
+            norm = std::fabs(a[i]);
+        }
+    }
+    return norm;
+}
+
+}
+
+CompactPCG::CompactPCG(Settings::Ptr s) :
+        PressureSolver(s, COMPACT_PRECONDITIONED_CONJUGATE_GRADIENT),
+        _tol(s->tolerance),
+        _maxIterations(s->maxIterations)
+{
+    // The full grid matrix is never used
+    PressureSolver::_A.resize(0,0,1.f);
+}
+
+void CompactPCG::buildLinearSystem(Grid::Ptr grid,
+                                   SolidSDF::Ptr solid,
+                                   FluidSDF::Ptr fluid,
+                                   float dt)
+{
+    LOG_DEBUG("Building the compact linear system for the pressure equation.");
+    const Array2f & phi = fluid->phi();
+    const FaceArray2Xf & uw = grid->uWeights();
+    const FaceArray2Yf & vw = grid->vWeights();
+    _compactA.buildIndex(phi);
+
+    const int n = _compactA.rows();
+    const float scale = dt / (sqr(phi.dx()));
+#pragma omp parallel for
+    for (int r = 0; r < n; ++r) {
+        float center, right, top;
+        const int i = _compactA.cellI(r);
+        const int j = _compactA.cellJ(r);
+        _laplaceRow(uw, vw, phi, i, j, center, right, top);
+        _compactA.value<CENTER>(r) = center * scale;
+        _compactA.value<RIGHT>(r) = right * scale;
+        _compactA.value<TOP>(r) = top * scale;
+    }
+    _compactA.symmetrize();
+
+    _buildRHS(grid->u(), grid->v(), uw, vw, fluid, _b);
+    _r.resize(n);
+    _compactA.gather(_b, &_r[0]);
+
+    _p.resize(n);
+    _z.resize(n);
+    _s.resize(n);
+    _q.resize(n);
+    _precon.resize(n);
+    _buildPreconditioner();
+    LOG_DEBUG("The compact system has " << n << " rows (" <<
+               100.0 * n / (phi.nx() * phi.ny()) << "% of the grid).");
+}
+
+void CompactPCG::solveLinearSystem(FluidSDF::Ptr f, float dt)
+{
+    LOG_DEBUG("Solving the compact linear system with PCG.");
+    Timer timer;
+    _solveIterations = 0;
+    _solveResidual = 0;
+    _solveTime = 0;
+    const int n = _compactA.rows();
+    const float bNorm = infNorm(_r);
+    float tol = _tol * bNorm;
+    if (_initialGuess(f->phi(), dt, _pressure)) {
+        // Residual-based startup, r = b - Ap
+        _compactA.gather(_pressure, &_p[0]);
+        _compactA.mult(&_p[0], &_z[0]);
+        for (int k = 0; k < n; ++k) {
+            _r[k] -= _z[k];
+        }
+        LOG_DEBUG("Warm start reduced the initial residual from " << bNorm <<
+                   " to " << infNorm(_r) << ".");
+    } else {
+        std::fill(_p.begin(), _p.end(), 0.0f);
+    }
+    _solveInitialResidual = infNorm(_r);
+    if (_solveInitialResidual <= tol) {
+        _solveResidual = _solveInitialResidual;
+        _compactA.scatter(&_p[0], _pressure);
+        return;
+    }
+
+    _applyPreconditioner();
+    _s = _z;
+    float rho = dot(_z, _r);
+    if (rho == 0) {
+        return;
+    }
+
+    int iter;
+    for (iter = 0; iter < _maxIterations; ++iter) {
+        _compactA.mult(&_s[0], &_z[0]);
+        float alpha = rho / dot(_s, _z);
+        // Solution, residual and its norm in one pass
+        float norm = 0;
+        for (int k = 0; k < n; ++k) {
+            _p[k] += _s[k] * alpha;
+            _r[k] += _z[k] * -alpha;
+            norm = std::max(norm, std::fabs(_r[k]));
+        }
+        if (norm <= tol) {
+            break;
+        }
+        _applyPreconditioner();
+        float rhoNew = dot(_z, _r);
+        float beta = rhoNew / rho;
+        for (int k = 0; k < n; ++k) {
+            _s[k] = _s[k] * beta + _z[k];
+        }
+        rho = rhoNew;
+    }
+
+    _compactA.scatter(&_p[0], _pressure);
+    _solveIterations = iter;
+    _solveResidual = infNorm(_r);
+    _solveTime = timer.elapsed();
+    if (iter < _maxIterations) {
+        LOG_OUTPUT("Compact PCG converged in " << iter << " iterations (" <<
+                   1000 * _solveTime << " ms).");
+    } else {
+        LOG_OUTPUT("Compact PCG did not converge with tolerance = " << tol <<
+                   " (" << 1000 * _solveTime << " ms).");
+    }
+    LOG_OUTPUT("The residual norm |r| = " << _solveResidual << ".");
+}
+
+void CompactPCG::_buildPreconditioner()
+{
+    // MIC(0) in natural ordering, as in PCG. The cells on the lower grid
+    // boundaries get no preconditioner there, so that is kept here.
+    const float mic = 0.99;
+    const float safety = 0.25;
+    float e;
+    for (int r = 0; r < _compactA.rows(); ++r) {
+        _precon[r] = 0;
+        if (_compactA.cellI(r) == 0 || _compactA.cellJ(r) == 0) {
+            continue;
+        }
+        const int ri = _compactA.neighbor<LEFT>(r);
+        const int rj = _compactA.neighbor<BOTTOM>(r);
+        const bool hasI = _compactA.hasNeighbor<LEFT>(r);
+        const bool hasJ = _compactA.hasNeighbor<BOTTOM>(r);
+        const float a = _compactA.value<CENTER>(r);
+        const float aii = _compactA.value<LEFT>(r);
+        const float aij = hasJ ? _compactA.value<RIGHT>(rj) : 0;
+        const float aji = hasI ? _compactA.value<TOP>(ri) : 0;
+        const float ajj = _compactA.value<BOTTOM>(r);
+        const float pi = hasI ? _precon[ri] : 0;
+        const float pj = hasJ ? _precon[rj] : 0;
+
+        e = a - sqr(aii*pi) - sqr(ajj*pj) -
+                mic*(aii*aji*sqr(pi) + aij*ajj*sqr(pj));
+
+        if (e < safety * a) {
+            e = a;
+        }
+        _precon[r] = 1.0 / sqrt(e + 1e-6);
+    }
+}
+
+void CompactPCG::_applyPreconditioner()
+{
+    const int n = _compactA.rows();
+    const int nx = _pressure.nx();
+    const int ny = _pressure.ny();
+    float t;
+
+    // Solve Lq = r
+    for (int r = 0; r < n; ++r) {
+        t = _r[r];
+        if (_compactA.hasNeighbor<LEFT>(r)) {
+            const int k = _compactA.neighbor<LEFT>(r);
+            t -= _compactA.value<LEFT>(r) * _precon[k] * _q[k];
+        }
+        if (_compactA.hasNeighbor<BOTTOM>(r)) {
+            const int k = _compactA.neighbor<BOTTOM>(r);
+            t -= _compactA.value<BOTTOM>(r) * _precon[k] * _q[k];
+        }
+        _q[r] = t * _precon[r];
+    }
+
+    // Solve L^Tz = q. PCG skips the cells on the upper grid boundaries.
+    for (int r = n - 1; r >= 0; --r) {
+        if (_compactA.cellI(r) == nx - 1 || _compactA.cellJ(r) == ny - 1) {
+            _z[r] = 0;
+            continue;
+        }
+        t = _q[r];
+        if (_compactA.hasNeighbor<RIGHT>(r)) {
+            const int k = _compactA.neighbor<RIGHT>(r);
+            t -= _compactA.value<RIGHT>(r) * _precon[r] * _z[k];
+        }
+        if (_compactA.hasNeighbor<TOP>(r)) {
+            const int k = _compactA.neighbor<TOP>(r);
+            t -= _compactA.value<TOP>(r) * _precon[r] * _z[k];
+        }
+        _z[r] = t * _precon[r];
+    }
+}
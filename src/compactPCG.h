@@ -0,0 +1,50 @@
+#ifndef COMPACT_PCG_H_
+#define COMPACT_PCG_H_
+
+#include "pressure.h"
+#include "compact.h"
+#include "aligned.h"
+
+/**
+    PCG with a MIC(0) preconditioner on a pressure system that only holds
+    the fluid cells. All solver vectors are dense over the fluid cells, so
+    the memory traffic per iteration scales with the fluid volume instead
+    of the domain size. Uses the same operation order as PCG.
+*/
+class CompactPCG : public PressureSolver
+{
+  public:
+    static Ptr create(Settings::Ptr s)
+    {
+        return new CompactPCG(s);
+    }
+
+    virtual void buildLinearSystem(Grid::Ptr grid,
+                                   SolidSDF::Ptr solid,
+                                   FluidSDF::Ptr fluid,
+                                   float dt);
+
+    virtual void solveLinearSystem(FluidSDF::Ptr f, float dt);
+
+  protected:
+    CompactLaplacianMatrix<float> _compactA;
+    AlignedVectorf _p;
+    AlignedVectorf _r;
+    AlignedVectorf _z;
+    AlignedVectorf _s;
+    AlignedVectorf _q;
+    AlignedVectorf _precon;
+    float _tol;
+    int _maxIterations;
+
+    CompactPCG(Settings::Ptr s);
+    CompactPCG();
+    CompactPCG(const CompactPCG &);
+    void operator=(const CompactPCG&);
+
+    void _buildPreconditioner();
+
+    void _applyPreconditioner();
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "compress.h"
+#include <stdint.h>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+
+enum Method
+{
+    RAW = 0,
+    RANS = 1,
+    CONSTANT = 2
+};
+
+const int SCALE_BITS = 12;
+const uint32_t SCALE = 1u << SCALE_BITS;
+const uint32_t RANS_L = 1u << 23;
+
+template<typename T>
+void put(std::ostream & out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool get(std::istream & in, T & value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+// Scales the symbol counts to sum to SCALE, keeping used symbols nonzero
+void normalize(const size_t * counts, size_t n, uint32_t * freq)
+{
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; ++s) {
+        freq[s] = counts[s] ? static_cast<uint32_t>(
+                static_cast<uint64_t>(counts[s]) * SCALE / n) : 0;
+        if (counts[s] && !freq[s]) {
+            freq[s] = 1;
+        }
+        sum += freq[s];
+    }
+    while (sum != SCALE) {
+        int largest = 0;
+        for (int s = 1; s < 256; ++s) {
+            if (freq[s] > freq[largest]) {
+                largest = s;
+            }
+        }
+        if (sum < SCALE) {
+            freq[largest] += SCALE - sum;
+            sum = SCALE;
+        } else {
+            const uint32_t d = std::min(sum - SCALE, freq[largest] - 1);
+            freq[largest] -= d;
+            sum -= d;
+        }
+    }
+}
+
+}
+
+void encodeBytes(std::ostream & out, const std::vector<unsigned char> & bytes)
+{
+    const size_t n = bytes.size();
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < n; ++i) {
+        ++counts[bytes[i]];
+    }
+    for (int s = 0; s < 256; ++s) {
+        if (counts[s] == n && n) {
+            put<uint8_t>(out, CONSTANT);
+            put<uint8_t>(out, s);
+            return;
+        }
+    }
+
+    uint32_t freq[256];
+    uint32_t start[256];
+    if (n) {
+        normalize(counts, n, freq);
+    }
+    uint32_t c = 0;
+    for (int s = 0; s < 256; ++s) {
+        start[s] = c;
+        c += n ? freq[s] : 0;
+    }
+
+    // rANS encodes backwards, the decoder reads the buffer forwards
+    std::vector<unsigned char> buffer(2 * n + 16);
+    unsigned char * ptr = &buffer[0] + buffer.size();
+    uint32_t x = RANS_L;
+    for (size_t i = n; i-- > 0;) {
+        const uint32_t f = freq[bytes[i]];
+        const uint32_t xMax = ((RANS_L >> SCALE_BITS) << 8) * f;
+        while (x >= xMax) {
+            *--ptr = static_cast<unsigned char>(x & 0xff);
+            x >>= 8;
+        }
+        x = ((x / f) << SCALE_BITS) + (x % f) + start[bytes[i]];
+    }
+    for (int k = 0; k < 4; ++k) {
+        *--ptr = static_cast<unsigned char>(x >> (8 * k));
+    }
+    const size_t size = &buffer[0] + buffer.size() - ptr;
+
+    const size_t tableSize = 256 * sizeof(uint16_t) + sizeof(uint32_t);
+    if (!n || size + tableSize >= n) {
+        put<uint8_t>(out, RAW);
+        if (n) {
+            out.write(reinterpret_cast<const char*>(&bytes[0]), n);
+        }
+        return;
+    }
+    put<uint8_t>(out, RANS);
+    for (int s = 0; s < 256; ++s) {
+        put<uint16_t>(out, static_cast<uint16_t>(freq[s]));
+    }
+    put<uint32_t>(out, static_cast<uint32_t>(size));
+    out.write(reinterpret_cast<const char*>(ptr), size);
+}
+
+bool decodeBytes(std::istream & in, std::vector<unsigned char> & bytes,
+                 size_t n)
+{
+    bytes.resize(n);
+    uint8_t method;
+    if (!get(in, method)) {
+        return false;
+    }
+    if (method == CONSTANT) {
+        uint8_t s;
+        if (!get(in, s)) {
+            return false;
+        }
+        std::fill(bytes.begin(), bytes.end(), s);
+        return true;
+    }
+    if (method == RAW) {
+        if (n) {
+            in.read(reinterpret_cast<char*>(&bytes[0]), n);
+        }
+        return n == 0 || in.good();
+    }
+    if (method != RANS) {
+        return false;
+    }
+
+    uint32_t freq[256];
+    uint32_t start[256];
+    unsigned char symbol[SCALE];
+    uint32_t c = 0;
+    for (int s = 0; s < 256; ++s) {
+        uint16_t f;
+        if (!get(in, f) || c + f > SCALE) {
+            return false;
+        }
+        freq[s] = f;
+        start[s] = c;
+        for (uint32_t k = 0; k < f; ++k) {
+            symbol[c + k] = static_cast<unsigned char>(s);
+        }
+        c += f;
+    }
+    uint32_t size;
+    if (c != SCALE || !get(in, size) || size < 4) {
+        return false;
+    }
+    std::vector<unsigned char> buffer(size);
+    in.read(reinterpret_cast<char*>(&buffer[0]), size);
+    if (!in.good()) {
+        return false;
+    }
+
+    const unsigned char * ptr = &buffer[0];
+    const unsigned char * end = ptr + size;
+    uint32_t x = 0;
+    for (int k = 0; k < 4; ++k) {
+        x = (x << 8) | *ptr++;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t slot = x & (SCALE - 1);
+        const unsigned char s = symbol[slot];
+        bytes[i] = s;
+        x = freq[s] * (x >> SCALE_BITS) + slot - start[s];
+        while (x < RANS_L) {
+            if (ptr == end) {
+                return false;
+            }
+            x = (x << 8) | *ptr++;
+        }
+    }
+    return true;
+}
+
+void encodeStream(std::ostream & out, const std::vector<unsigned int> & values)
+{
+    const size_t n = values.size();
+    std::vector<unsigned int> zigzag(n);
+    uint32_t previous = 0;
+    uint32_t largest = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const int32_t d = static_cast<int32_t>(values[i] - previous);
+        zigzag[i] = (static_cast<uint32_t>(d) << 1) ^
+                static_cast<uint32_t>(d >> 31);
+        previous = values[i];
+        largest = std::max(largest, zigzag[i]);
+    }
+
+    uint8_t width = 1;
+    while (width < 4 && (largest >> (8 * width))) {
+        ++width;
+    }
+    put<uint8_t>(out, width);
+    std::vector<unsigned char> plane(n);
+    for (int b = 0; b < width; ++b) {
+        for (size_t i = 0; i < n; ++i) {
+            plane[i] = static_cast<unsigned char>(zigzag[i] >> (8 * b));
+        }
+        encodeBytes(out, plane);
+    }
+}
+
+bool decodeStream(std::istream & in, std::vector<unsigned int> & values,
+                  size_t n)
+{
+    uint8_t width;
+    if (!get(in, width) || width < 1 || width > 4) {
+        return false;
+    }
+    values.assign(n, 0);
+    std::vector<unsigned char> plane;
+    for (int b = 0; b < width; ++b) {
+        if (!decodeBytes(in, plane, n)) {
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            values[i] |= static_cast<uint32_t>(plane[i]) << (8 * b);
+        }
+    }
+    uint32_t previous = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t z = values[i];
+        const uint32_t d = (z >> 1) ^ (0u - (z & 1));
+        previous += d;
+        values[i] = previous;
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include <vector>
+#include <iostream>
+
+/**
+    Lossless coding of integer streams for the compressed frame format.
+    A stream is delta coded, zigzag mapped to small unsigned values and
+    split into byte planes (byte shuffle), so that each plane holds bytes
+    of the same significance. Every plane is then entropy coded with a
+    static order-0 rANS coder, or stored raw if that is not smaller.
+*/
+void encodeStream(std::ostream & out, const std::vector<unsigned int> & values);
+
+// Reads a stream of n values written by encodeStream
+bool decodeStream(std::istream & in, std::vector<unsigned int> & values,
+                  size_t n);
+
+// Order-0 rANS coding of a byte buffer, with a raw fallback
+void encodeBytes(std::ostream & out, const std::vector<unsigned char> & bytes);
+
+bool decodeBytes(std::istream & in, std::vector<unsigned char> & bytes,
+                 size_t n);
+
+#endif
@@ -1,23 +1,43 @@
 #include "flip2D.h"
 #include "util.h"
 #include "pcg.h"
+#include "compactPCG.h"
+#include "mgpcg.h"
 #include "multigrid.h"
 #include "gaussSeidel.h"
 #include "jacobi.h"
 #include "log.h"
+#include "parallel.h"
+#include "frame.h"
 #include <fstream>
+#include <sstream>
+#include <cstring>
 
-FLIP2D::FLIP2D(Settings::Ptr s) : _settings(s)
+namespace {
+const char CHECKPOINT_MAGIC[4] = {'F', '2', 'D', 'C'};
+const uint32_t CHECKPOINT_VERSION = 3;
+}
+
+FLIP2D::FLIP2D(Settings::Ptr s, bool initialize) :
+        _settings(s), _numSubsteps(0), _random(s->seed)
 {
     LOG_OUTPUT("Initiating FLIP2D simulation");
+    setNumThreads(s->numThreads);
     
     _grid = Grid::create(s);
     _particles = Particles::create();
     _fluid = FluidSDF::create(s);
     _solid = SolidSDF::create(s);
+    if (s->outputQueueDepth > 0) {
+        _frameWriter = FrameWriter::create(s->outputQueueDepth);
+    }
 
-    if (s->usePCG) {
+    if (s->usePCG && s->useCompactSystem) {
+        _pressureSolver = CompactPCG::create(s);
+    } else if (s->usePCG) {
         _pressureSolver = PCG::create(s);
+    } else if (s->useMGPCG) {
+        _pressureSolver = MGPCG::create(s);
     } else if (s->useMultigrid) {
         _pressureSolver = Multigrid::create(s);
     } else if (s->useGaussSeidel) {
@@ -28,49 +48,93 @@ FLIP2D::FLIP2D(Settings::Ptr s) : _settings(s)
         LOG_ERROR("Could not create a pressure solver.");
     }
 
+    if (!initialize) {
+        return;
+    }
+
     // Init Solid SDF and spawn fluid particles
     _solid->initBoxBoundary(s->solidWidth);
     _particles->initSphere(_solid->phi(),
                            _settings->initialFluidCenter,
                            _settings->initialFluidRadius,
                            _settings->particlesPerCell,
-                           _settings->initialVelocity);
+                           _settings->initialVelocity,
+                           _random);
 }
 
-void FLIP2D::step(float dt)
+const StepStats & FLIP2D::step(float dt)
 {
     LOG_OUTPUT("Stepping with dt = " << dt << " seconds.");
+    _stats.reset();
+    Timer total;
+    Timer timer;
     float tStep = 0;
     while (tStep < dt) {
+        if (_settings->particleSortInterval > 0 &&
+            _numSubsteps % _settings->particleSortInterval == 0) {
+            _particles->sortByCell(_settings->nx,
+                                   _settings->ny,
+                                   _settings->dx);
+        }
+        _stats.record(StepStats::SORT_PARTICLES, timer);
         _grid->sampleVelocities(_particles);
         const float t = min(_grid->CFL(), dt - tStep);
         if (t != dt) {
-            LOG_OUTPUT("Substepping with dt = " << dt << " seconds.");
+            LOG_DEBUG("Substepping with dt = " << dt << " seconds.");
         }
+        _stats.record(StepStats::SAMPLE_VELOCITIES, timer);
         
         _fluid->reconstructSurface(_particles, _settings->R, _settings->r);
+        _stats.record(StepStats::RECONSTRUCT_SURFACE, timer);
         _fluid->reinitialize(_settings->numPhiSweepIterations);
+        _stats.record(StepStats::REINITIALIZE, timer);
         _fluid->extrapolateIntoSolid(_solid);
+        _stats.record(StepStats::EXTRAPOLATE_INTO_SOLID, timer);
         _grid->applyGravity(_settings->gravity, t);
+        _stats.record(StepStats::APPLY_GRAVITY, timer);
         _grid->extrapolateVelocities(_fluid, _settings->numVelSweepIterations);
+        _stats.record(StepStats::EXTRAPOLATE_VELOCITIES, timer);
         _pressureSolver->buildLinearSystem(_grid, _solid, _fluid, t);
+        _stats.record(StepStats::BUILD_PRESSURE, timer);
         _pressureSolver->solveLinearSystem(_fluid, t);
+        _stats.record(StepStats::SOLVE_PRESSURE, timer);
         _grid->pressureProjection(_pressureSolver->pressure(), _fluid, t);
+        _stats.record(StepStats::PRESSURE_PROJECTION, timer);
         _grid->extrapolateVelocities(_fluid, _settings->numVelSweepIterations);
+        _stats.record(StepStats::EXTRAPOLATE_PROJECTED, timer);
         _grid->enforceBoundaryConditions(_solid);
+        _stats.record(StepStats::ENFORCE_BOUNDARY, timer);
         _particles->advect(_grid->u(), _grid->v(), t);
+        _stats.record(StepStats::ADVECT, timer);
         _particles->updateVelocities(_grid->u(), _grid->v());
+        _stats.record(StepStats::UPDATE_VELOCITIES, timer);
+
+        _stats.solverIterations += _pressureSolver->solveIterations();
+        _stats.solverResidual = _pressureSolver->solveResidual();
+        ++_stats.numSubsteps;
         tStep += t;
+        ++_numSubsteps;
     }
+    _stats.numParticles = _particles->numParticles();
+    _stats.numFluidCells = _fluid->numFluidCells();
+    _stats.totalTime = total.elapsed();
+    return _stats;
 }
 
 bool FLIP2D::write(const char * filename) const
 {
+    if (_frameWriter) {
+        _frameWriter.ptr()->write(filename, *_settings.ptr(),
+                                  *_particles.ptr());
+        return true;
+    }
     std::ofstream out(filename, std::ios::out | std::ios::binary);
     if (out.is_open()) {
         LOG_OUTPUT("Writing simulation output to " << filename);
-        _settings->write(out);
-        _particles->write(out);    
+        std::ostringstream settings;
+        _settings->write(settings);
+        writeFrame(out, settings.str(), *_particles.ptr(),
+                   FrameFormat(*_settings.ptr()));
         out.close();
         return true;
     } else {
@@ -79,13 +143,42 @@ bool FLIP2D::write(const char * filename) const
     }
 }
 
+bool FLIP2D::append(const char * sequence, int frame) const
+{
+    if (_frameWriter) {
+        _frameWriter.ptr()->append(sequence, frame, *_settings.ptr(),
+                                   *_particles.ptr());
+        return true;
+    }
+    if (!_sequence || _sequence->filename() != sequence) {
+        _sequence = SequenceWriter::open(sequence);
+    }
+    if (!_sequence) {
+        return false;
+    }
+    LOG_OUTPUT("Appending frame " << frame << " to " << sequence);
+    std::ostringstream settings;
+    _settings->write(settings);
+    return _sequence->append(frame, settings.str(), *_particles.ptr(),
+                             FrameFormat(*_settings.ptr()));
+}
+
+void FLIP2D::flush() const
+{
+    if (_frameWriter) {
+        _frameWriter.ptr()->flush();
+    }
+}
+
 bool FLIP2D::read(const char * filename, Settings::Ptr s, Particles::Ptr p)
 {
     std::ifstream in(filename, std::ios::in | std::ios::binary);
     if (in.is_open()) {
         LOG_OUTPUT("Reading simulation input from " << filename);
-        s->read(in);
-        p->read(in);
+        if (!readFrame(in, *s.ptr(), *p.ptr())) {
+            LOG_ERROR("Corrupt simulation input in " << filename);
+            return false;
+        }
         in.close();
         return true;
     } else {
@@ -94,3 +187,93 @@ bool FLIP2D::read(const char * filename, Settings::Ptr s, Particles::Ptr p)
     }
 }
 
+
+bool FLIP2D::read(const char * sequence,
+                  int i,
+                  Settings::Ptr s,
+                  Particles::Ptr p)
+{
+    SequenceReader::Ptr reader = SequenceReader::open(sequence);
+    if (!reader) {
+        return false;
+    }
+    LOG_OUTPUT("Reading frame " << i << " of " << sequence);
+    return reader->read(i, *s.ptr(), *p.ptr());
+}
+
+bool FLIP2D::checkpoint(const char * filename) const
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+        LOG_ERROR("Could not write checkpoint to " << filename);
+        return false;
+    }
+    LOG_OUTPUT("Writing checkpoint to " << filename);
+    const int32_t numSubsteps = _numSubsteps;
+    const uint64_t state = _random.state();
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    out.write(reinterpret_cast<const char*>(&CHECKPOINT_VERSION),
+              sizeof(CHECKPOINT_VERSION));
+    _settings.ptr()->writeCheckpoint(out);
+    out.write(reinterpret_cast<const char*>(&numSubsteps), sizeof(int32_t));
+    out.write(reinterpret_cast<const char*>(&state), sizeof(uint64_t));
+    _particles.ptr()->write(out);
+    _grid.ptr()->writeState(out);
+    _fluid.ptr()->writeState(out);
+    _solid.ptr()->writeState(out);
+    _pressureSolver.ptr()->writeState(out);
+    out.close();
+    if (!out) {
+        LOG_ERROR("Could not write checkpoint to " << filename);
+        return false;
+    }
+    return true;
+}
+
+FLIP2D::Ptr FLIP2D::restore(const char * filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        LOG_ERROR("Could not read checkpoint from " << filename);
+        return FLIP2D::Ptr();
+    }
+    LOG_OUTPUT("Restoring checkpoint from " << filename);
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint32_t version = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!in || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0) {
+        LOG_ERROR(filename << " is not a checkpoint");
+        return FLIP2D::Ptr();
+    }
+    if (version < 1 || version > CHECKPOINT_VERSION) {
+        LOG_ERROR("Unsupported checkpoint version " << version << " in "
+                  << filename);
+        return FLIP2D::Ptr();
+    }
+
+    Settings::Ptr s = Settings::create();
+    s->readCheckpoint(in, version);
+    if (!in) {
+        LOG_ERROR("Corrupt checkpoint settings in " << filename);
+        return FLIP2D::Ptr();
+    }
+    FLIP2D::Ptr flip = new FLIP2D(s, false);
+    int32_t numSubsteps = 0;
+    uint64_t state = 0;
+    in.read(reinterpret_cast<char*>(&numSubsteps), sizeof(int32_t));
+    in.read(reinterpret_cast<char*>(&state), sizeof(uint64_t));
+    flip->_numSubsteps = numSubsteps;
+    flip->_random.setState(state);
+    flip->_particles->read(in);
+    const bool ok = in.good() &&
+            flip->_grid->readState(in) &&
+            flip->_fluid->readState(in) &&
+            flip->_solid->readState(in) &&
+            flip->_pressureSolver->readState(in);
+    if (!ok) {
+        LOG_ERROR("Corrupt checkpoint state in " << filename);
+        return FLIP2D::Ptr();
+    }
+    return flip;
+}
@@ -5,6 +5,9 @@
 #include "settings.h"
 #include "grid.h"
 #include "pressure.h"
+#include "stats.h"
+#include "frameWriter.h"
+#include "random.h"
 
 class FLIP2D : public SmartPtrInterface<FLIP2D>
 {
@@ -13,11 +16,34 @@ class FLIP2D : public SmartPtrInterface<FLIP2D>
     
     static FLIP2D::Ptr create(Settings::Ptr s) { return new FLIP2D(s); }
 
-    void step(float dt);
+    // Returns the timings and counters of the step
+    const StepStats & step(float dt);
 
+    const StepStats & stats() const { return _stats; }
+
+    // Writes in the background if Settings::outputQueueDepth > 0
     bool write(const char * filename) const;
 
+    // Appends the frame to a sequence file, which holds many frames
+    bool append(const char * sequence, int frame) const;
+
+    // Waits for the background writes to finish
+    void flush() const;
+
     static bool read(const char * filename, Settings::Ptr s, Particles::Ptr p);
+
+    // Reads the i:th frame of a sequence file
+    static bool read(const char * sequence,
+                     int i,
+                     Settings::Ptr s,
+                     Particles::Ptr p);
+
+    // Writes the complete simulation state. A simulation restored from the
+    // checkpoint continues bit-exactly where this one would have.
+    bool checkpoint(const char * filename) const;
+
+    // Returns a null pointer if the checkpoint could not be read
+    static FLIP2D::Ptr restore(const char * filename);
     
   protected:
     Settings::Ptr _settings;
@@ -26,8 +52,15 @@ class FLIP2D : public SmartPtrInterface<FLIP2D>
     FluidSDF::Ptr _fluid;
     SolidSDF::Ptr _solid;
     PressureSolver::Ptr _pressureSolver;
+    int _numSubsteps;
+    StepStats _stats;
+    FrameWriter::Ptr _frameWriter;
+    mutable SequenceWriter::Ptr _sequence;
+    Random _random;
     
-    FLIP2D(Settings::Ptr s);
+    // Skips the initial conditions if initialize is false, restore() fills
+    // in the state instead
+    FLIP2D(Settings::Ptr s, bool initialize = true);
     
   private:
     FLIP2D();
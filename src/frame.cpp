@@ -0,0 +1,69 @@
+#include "frame.h"
+#include <cstring>
+#include <stdint.h>
+
+namespace
+{
+
+const char MAGIC[4] = { 'F', '2', 'D', 'Z' };
+
+}
+
+FrameFormat::FrameFormat() :
+        compressed(false),
+        positionError(0),
+        velocityError(0)
+{
+}
+
+FrameFormat::FrameFormat(const Settings & s) :
+        compressed(s.compressOutput),
+        positionError(s.outputPositionError),
+        velocityError(s.outputVelocityError),
+        extent(s.nx * s.dx, s.ny * s.dx)
+{
+}
+
+void writeFrame(std::ostream & out,
+                const std::string & settings,
+                const Particles & p,
+                const FrameFormat & format)
+{
+    if (format.compressed) {
+        const uint32_t version = FrameFormat::VERSION;
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    out.write(settings.data(), settings.size());
+    if (format.compressed) {
+        p.writeCompressed(out,
+                          format.extent,
+                          format.positionError,
+                          format.velocityError);
+    } else {
+        p.write(out);
+    }
+}
+
+bool readFrame(std::istream & in, Settings & s, Particles & p)
+{
+    // Legacy files start with Settings::nx, which never matches the magic
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(magic));
+    const bool compressed = in.good() && !memcmp(magic, MAGIC, sizeof(MAGIC));
+    if (!compressed) {
+        in.clear();
+        in.seekg(0, std::ios::beg);
+        s.read(in);
+        p.read(in);
+        return !in.fail();
+    }
+
+    uint32_t version;
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!in.good() || version > FrameFormat::VERSION) {
+        return false;
+    }
+    s.read(in);
+    return p.readCompressed(in);
+}
@@ -0,0 +1,38 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include "settings.h"
+#include "particles.h"
+#include <string>
+
+/**
+    Simulation frame files. The legacy format is the serialized Settings
+    followed by the raw particles. The compressed format starts with the
+    magic "F2DZ" and a version number, followed by the serialized Settings
+    and a compressed particle block (Particles::writeCompressed).
+*/
+struct FrameFormat
+{
+    enum { VERSION = 1 };
+
+    bool compressed;
+    float positionError;
+    float velocityError;
+    Vec2f extent;
+
+    // The legacy format
+    FrameFormat();
+
+    FrameFormat(const Settings & s);
+};
+
+// Writes a frame, settings holds the output of Settings::write
+void writeFrame(std::ostream & out,
+                const std::string & settings,
+                const Particles & p,
+                const FrameFormat & format);
+
+// Reads a frame in either format
+bool readFrame(std::istream & in, Settings & s, Particles & p);
+
+#endif
@@ -0,0 +1,212 @@
+#include "frameReader.h"
+#include "frame.h"
+#include "sequence.h"
+#include "log.h"
+#include <streambuf>
+#include <istream>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Stream over a memory range, to reuse the Settings and frame readers
+class MemoryBuffer : public std::streambuf
+{
+  public:
+    MemoryBuffer(const char * data, size_t size)
+    {
+        char * p = const_cast<char *>(data);
+        setg(p, p, p + size);
+    }
+
+    size_t consumed() const { return gptr() - eback(); }
+
+  protected:
+    virtual pos_type seekoff(off_type off,
+                             std::ios_base::seekdir dir,
+                             std::ios_base::openmode which)
+    {
+        char * p = dir == std::ios_base::beg ? eback() :
+                (dir == std::ios_base::cur ? gptr() : egptr());
+        p += off;
+        if (p < eback() || p > egptr()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), p, egptr());
+        return pos_type(p - eback());
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which)
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+}
+
+MappedFrame::MappedFrame() :
+        _data(0),
+        _size(0),
+        _settings(Settings::create())
+{
+}
+
+MappedFrame::~MappedFrame()
+{
+    if (!_data) {
+        return;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+    UnmapViewOfFile(_data);
+#else
+    munmap(const_cast<char *>(_data), _size);
+#endif
+}
+
+MappedFrame::Ptr MappedFrame::open(const char * filename, int index)
+{
+    MappedFrame::Ptr frame = new MappedFrame();
+    if (!frame->_map(filename)) {
+        LOG_ERROR("Could not map simulation input " << filename);
+        return 0;
+    }
+    const char * data = frame->_data;
+    size_t size = frame->_size;
+    if (index >= 0 && !frame->_locate(index, data, size)) {
+        LOG_ERROR("Could not find frame " << index << " in " << filename);
+        return 0;
+    }
+    if (!frame->_parse(data, size)) {
+        LOG_ERROR("Corrupt simulation input in " << filename);
+        return 0;
+    }
+    return frame;
+}
+
+bool MappedFrame::_map(const char * filename)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    _data = static_cast<const char *>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    _size = static_cast<size_t>(size.QuadPart);
+    return _data != 0;
+#else
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void * p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    _data = static_cast<const char *>(p);
+    _size = st.st_size;
+    return true;
+#endif
+}
+
+bool MappedFrame::_locate(int index, const char * & data, size_t & size) const
+{
+    MemoryBuffer buffer(_data, _size);
+    std::istream in(&buffer);
+    std::vector<SequenceEntry> entries;
+    uint64_t end;
+    bool recovered;
+    if (!readSequenceIndex(in, _size, entries, end, recovered) ||
+        index >= static_cast<int>(entries.size())) {
+        return false;
+    }
+    const SequenceEntry & e = entries[index];
+    data = _data + e.offset;
+    size = e.length;
+    return checksum(data, size) == e.checksum;
+}
+
+bool MappedFrame::_parse(const char * data, size_t size)
+{
+    MemoryBuffer buffer(data, size);
+    std::istream in(&buffer);
+
+    const bool compressed = size >= 4 && !memcmp(data, "F2DZ", 4);
+    if (compressed) {
+        _decoded = Particles::create();
+        if (!readFrame(in, *_settings.ptr(), *_decoded.ptr())) {
+            return false;
+        }
+        const int n = _decoded->numParticles();
+        _posX = FloatView(_decoded->posX(), sizeof(float), n);
+        _posY = FloatView(_decoded->posY(), sizeof(float), n);
+        _velX = FloatView(_decoded->velX(), sizeof(float), n);
+        _velY = FloatView(_decoded->velY(), sizeof(float), n);
+        return true;
+    }
+
+    // Legacy: settings, N, N interleaved positions, N interleaved velocities
+    _settings->read(in);
+    int n;
+    in.read(reinterpret_cast<char *>(&n), sizeof(int));
+    const size_t offset = buffer.consumed();
+    if (!in.good() || n < 0 ||
+        offset + 2 * sizeof(Vec2f) * static_cast<size_t>(n) > size) {
+        return false;
+    }
+    const char * pos = data + offset;
+    const char * vel = pos + sizeof(Vec2f) * n;
+    _posX = FloatView(pos, sizeof(Vec2f), n);
+    _posY = FloatView(pos + sizeof(float), sizeof(Vec2f), n);
+    _velX = FloatView(vel, sizeof(Vec2f), n);
+    _velY = FloatView(vel + sizeof(float), sizeof(Vec2f), n);
+    return true;
+}
+
+FrameCache::FrameCache(int capacity) : _capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+MappedFrame::Ptr FrameCache::frame(const std::string & filename, int index)
+{
+    const Key key(filename, index);
+    for (FrameList::iterator it = _frames.begin(); it != _frames.end(); ++it) {
+        if (it->first == key) {
+            _frames.splice(_frames.begin(), _frames, it);
+            return it->second;
+        }
+    }
+
+    MappedFrame::Ptr frame = MappedFrame::open(filename.c_str(), index);
+    if (!frame) {
+        return 0;
+    }
+    _frames.push_front(std::make_pair(key, frame));
+    while (static_cast<int>(_frames.size()) > _capacity) {
+        _frames.pop_back();
+    }
+    return frame;
+}
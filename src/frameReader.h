@@ -0,0 +1,129 @@
+#ifndef FRAME_READER_H_
+#define FRAME_READER_H_
+
+#include "ptr.h"
+#include "settings.h"
+#include "particles.h"
+#include <string>
+#include <list>
+#include <cstring>
+
+/**
+    Read-only view of an array of T with a byte stride, so interleaved and
+    planar storage can be read the same way.
+*/
+template<typename T>
+class StridedView
+{
+  public:
+    StridedView() : _data(0), _stride(0), _size(0) {}
+
+    StridedView(const void * data, size_t stride, int size) :
+            _data(static_cast<const char *>(data)),
+            _stride(stride),
+            _size(size) {}
+
+    T operator[](int i) const
+    {
+        // memcpy, the mapped data is not guaranteed to be aligned
+        T value;
+        memcpy(&value, _data + i * _stride, sizeof(T));
+        return value;
+    }
+
+    int size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+  protected:
+    const char * _data;
+    size_t _stride;
+    int _size;
+};
+
+typedef StridedView<float> FloatView;
+
+/**
+    A frame file mapped into memory. For legacy frames the particle views
+    point straight into the mapping, so nothing is copied. Compressed frames
+    are decoded once when the frame is opened. Frames in a sequence file
+    (SequenceWriter) are mapped the same way.
+*/
+class MappedFrame : public SmartPtrInterface<MappedFrame>
+{
+  public:
+    typedef SmartPtr<MappedFrame> Ptr;
+
+    // Opens the index:th frame of a sequence file, or a frame file if index
+    // is -1. Returns a null pointer if the file can't be mapped or is corrupt
+    static Ptr open(const char * filename, int index = -1);
+
+    const Settings & settings() const { return *_settings.ptr(); }
+
+    int numParticles() const { return _posX.size(); }
+
+    const FloatView & posX() const { return _posX; }
+    const FloatView & posY() const { return _posY; }
+
+    // Zero if the frame was written without velocities
+    const FloatView & velX() const { return _velX; }
+    const FloatView & velY() const { return _velY; }
+
+    Vec2f pos(int i) const { return Vec2f(_posX[i], _posY[i]); }
+
+    size_t fileSize() const { return _size; }
+
+  protected:
+    const char * _data;
+    size_t _size;
+    Settings::Ptr _settings;
+    Particles::Ptr _decoded;
+    FloatView _posX;
+    FloatView _posY;
+    FloatView _velX;
+    FloatView _velY;
+
+    MappedFrame();
+    virtual ~MappedFrame();
+    MappedFrame(const MappedFrame &);
+    void operator=(const MappedFrame &);
+
+    bool _map(const char * filename);
+
+    // Finds the frame in the sequence
+    bool _locate(int index, const char * & data, size_t & size) const;
+
+    bool _parse(const char * data, size_t size);
+};
+
+/**
+    Least recently used cache of mapped frames, so scrubbing back and forth
+    through a sequence doesn't map or decode a frame again.
+*/
+class FrameCache : public SmartPtrInterface<FrameCache>
+{
+  public:
+    typedef SmartPtr<FrameCache> Ptr;
+
+    static Ptr create(int capacity) { return new FrameCache(capacity); }
+
+    // Returns the cached frame or maps it, null if it can't be read. index
+    // is as in MappedFrame::open.
+    MappedFrame::Ptr frame(const std::string & filename, int index = -1);
+
+    int size() const { return _frames.size(); }
+
+  protected:
+    typedef std::pair<std::string, int> Key;
+    typedef std::list<std::pair<Key, MappedFrame::Ptr> > FrameList;
+
+    int _capacity;
+    FrameList _frames;  // Most recently used first
+
+    FrameCache(int capacity);
+    FrameCache();
+    FrameCache(const FrameCache &);
+    void operator=(const FrameCache &);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "frameWriter.h"
+#include "log.h"
+#include <sstream>
+
+FrameWriter::FrameWriter(int maxQueued) :
+        _maxQueued(maxQueued > 0 ? maxQueued : 1),
+        _busy(false),
+        _stop(false),
+        _numFailed(0)
+{
+    _thread = std::thread(&FrameWriter::_run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _queued.notify_one();
+    _thread.join();
+}
+
+void FrameWriter::write(const char * filename,
+                        const Settings & s,
+                        const Particles & p)
+{
+    _push(filename, -1, s, p);
+}
+
+void FrameWriter::append(const char * sequence,
+                         int frame,
+                         const Settings & s,
+                         const Particles & p)
+{
+    _push(sequence, frame, s, p);
+}
+
+void FrameWriter::_push(const char * filename,
+                        int sequenceFrame,
+                        const Settings & s,
+                        const Particles & p)
+{
+    Frame frame;
+    frame.filename = filename;
+    frame.frame = sequenceFrame;
+    frame.format = FrameFormat(s);
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (static_cast<int>(_queue.size()) >= _maxQueued) {
+            _written.wait(lock);
+        }
+        if (_free.empty()) {
+            _snapshots.push_back(Particles::create());
+            _free.push_back(_snapshots.back().ptr());
+        }
+        frame.particles = _free.back();
+        _free.pop_back();
+    }
+
+    // The snapshot is not visible to the writer thread until it is queued
+    std::ostringstream settings;
+    s.write(settings);
+    frame.settings = settings.str();
+    frame.particles->copy(p);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(frame);
+    }
+    _queued.notify_one();
+}
+
+void FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_queue.empty() || _busy) {
+        _written.wait(lock);
+    }
+}
+
+int FrameWriter::numFailed() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numFailed;
+}
+
+void FrameWriter::_run()
+{
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_queue.empty() && !_stop) {
+                _queued.wait(lock);
+            }
+            if (_queue.empty()) {
+                return;
+            }
+            frame = _queue.front();
+            _queue.pop_front();
+            _busy = true;
+        }
+
+        const bool ok = _write(frame);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free.push_back(frame.particles);
+            _numFailed += !ok;
+            _busy = false;
+        }
+        _written.notify_all();
+    }
+}
+
+bool FrameWriter::_write(const Frame & frame)
+{
+    if (frame.frame >= 0) {
+        if (!_sequence || _sequence->filename() != frame.filename) {
+            _sequence = SequenceWriter::open(frame.filename.c_str());
+        }
+        if (!_sequence) {
+            return false;
+        }
+        LOG_OUTPUT("Appending frame " << frame.frame << " to " <<
+                   frame.filename);
+        return _sequence->append(frame.frame, frame.settings,
+                                 *frame.particles, frame.format);
+    }
+
+    std::ofstream out(frame.filename.c_str(),
+                      std::ios::out | std::ios::binary);
+    bool ok = out.is_open();
+    if (ok) {
+        LOG_OUTPUT("Writing simulation output to " << frame.filename);
+        writeFrame(out, frame.settings, *frame.particles, frame.format);
+        out.close();
+        ok = !out.fail();
+    }
+    if (!ok) {
+        LOG_ERROR("Could not write simulation output to " <<
+                  frame.filename);
+    }
+    return ok;
+}
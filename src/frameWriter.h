@@ -0,0 +1,86 @@
+#ifndef FRAME_WRITER_H_
+#define FRAME_WRITER_H_
+
+#include "ptr.h"
+#include "settings.h"
+#include "particles.h"
+#include "frame.h"
+#include "sequence.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+    Writes simulation frames from a background thread. write() copies the
+    particles into a snapshot buffer and returns, so the simulation keeps
+    stepping while the frame goes to disk. At most maxQueued frames wait in
+    the queue; write() blocks when it is full, which caps the memory at
+    maxQueued + 1 snapshots. Snapshot buffers are reused between frames.
+*/
+class FrameWriter : public SmartPtrInterface<FrameWriter>
+{
+  public:
+    typedef SmartPtr<FrameWriter> Ptr;
+
+    static Ptr create(int maxQueued) { return new FrameWriter(maxQueued); }
+
+    void write(const char * filename, const Settings & s, const Particles & p);
+
+    // Appends the frame to a sequence file (SequenceWriter)
+    void append(const char * sequence,
+                int frame,
+                const Settings & s,
+                const Particles & p);
+
+    // Blocks until every queued frame has been written
+    void flush();
+
+    // Number of frames that could not be written
+    int numFailed() const;
+
+  protected:
+    struct Frame
+    {
+        std::string filename;
+        int frame;  // In the sequence filename, -1 for a frame file
+        std::string settings;
+        FrameFormat format;
+        Particles * particles;
+    };
+
+    int _maxQueued;
+    bool _busy;
+    bool _stop;
+    int _numFailed;
+    // Owns the snapshots. Only touched by the calling thread, the writer
+    // thread only sees raw pointers.
+    std::vector<Particles::Ptr> _snapshots;
+    std::vector<Particles *> _free;
+    std::deque<Frame> _queue;
+    mutable std::mutex _mutex;
+    std::condition_variable _queued;
+    std::condition_variable _written;
+    std::thread _thread;
+    // The open sequence, only touched by the writer thread
+    SequenceWriter::Ptr _sequence;
+
+    FrameWriter(int maxQueued);
+    virtual ~FrameWriter();
+    FrameWriter();
+    FrameWriter(const FrameWriter &);
+    void operator=(const FrameWriter &);
+
+    void _push(const char * filename,
+               int frame,
+               const Settings & s,
+               const Particles & p);
+
+    bool _write(const Frame & frame);
+
+    void _run();
+};
+
+#endif
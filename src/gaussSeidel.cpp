@@ -1,4 +1,5 @@
 #include "gaussSeidel.h"
+#include "laplace.h"
 
 GaussSeidel::GaussSeidel(Settings::Ptr s) : PressureSolver(s, GAUSS_SEIDEL)
 {
@@ -7,11 +8,12 @@ GaussSeidel::GaussSeidel(Settings::Ptr s) : PressureSolver(s, GAUSS_SEIDEL)
 
 void GaussSeidel::solveLinearSystem(FluidSDF::Ptr fluid, float dt)
 {
-    _pressure.reset();
+    _initialGuess(fluid->phi(), dt, _pressure);
     for (int i = 0; i < _iterations; ++i) {
         redBlackIteration(true, fluid->phi(), _A, _b, _pressure);
         redBlackIteration(false, fluid->phi(),_A,  _b, _pressure);
     }
+    _solveIterations = _iterations;
 }
 
 void GaussSeidel::redBlackIteration(bool red,
@@ -20,13 +22,6 @@ void GaussSeidel::redBlackIteration(bool red,
                                     const Array2f & b,
                                     Array2f & p)
 {
-    int start = red ? 0 : 1;
-    for (int i = 0; i < p.nx(); ++i) {
-        for (int j = start + i % 2; j < p.ny(); j+=2) {
-            if (phi(i,j) < 0 && A.value<CENTER>(i,j)){
-                p(i,j) = (b(i,j)-A.multNeighbors(p,i,j)) / A.value<CENTER>(i,j);
-            }
-        }
-    }
+    relaxLaplace(A, b, phi, p, p, red ? 0 : 1);
 }
 
@@ -1,8 +1,30 @@
 #include "grid.h"
 #include "util.h"
 #include "log.h"
+#include "parallel.h"
+#include "wavefront.h"
 
-Grid::Grid(Settings::Ptr s)
+namespace
+{
+
+// Indices of the faces left, right, below and above, -1 outside the grid
+void faceNeighbours(int idx, int nx, int ny, int * neighbours)
+{
+    const int i = idx / ny;
+    const int j = idx - ny * i;
+    neighbours[0] = i > 0 ? idx - ny : -1;
+    neighbours[1] = i < nx - 1 ? idx + ny : -1;
+    neighbours[2] = j > 0 ? idx - 1 : -1;
+    neighbours[3] = j < ny - 1 ? idx + 1 : -1;
+}
+
+}
+
+Grid::Grid(Settings::Ptr s) :
+        _parallelSampling(s->useParallelSampling),
+        _bandExtrapolation(s->useBandExtrapolation),
+        _numExtrapolationLayers(s->numExtrapolationLayers),
+        _solidVersion(0)
 {
     _u.resize(s->nx,s->ny,s->dx);
     _v.resize(s->nx,s->ny,s->dx);
@@ -10,34 +32,94 @@ Grid::Grid(Settings::Ptr s)
     _vSum.resize(s->nx,s->ny,s->dx);
     _uWeights.resize(s->nx,s->ny,s->dx);
     _vWeights.resize(s->nx,s->ny,s->dx);
+    _uNormalX.resize(s->nx,s->ny,s->dx);
+    _uNormalY.resize(s->nx,s->ny,s->dx);
+    _vNormalX.resize(s->nx,s->ny,s->dx);
+    _vNormalY.resize(s->nx,s->ny,s->dx);
+}
+
+void Grid::writeState(std::ostream & out) const
+{
+    _u.write(out);
+    _v.write(out);
+    _uWeights.write(out);
+    _vWeights.write(out);
+}
+
+bool Grid::readState(std::istream & in)
+{
+    return _u.read(in) && _v.read(in) && _uWeights.read(in) &&
+            _vWeights.read(in);
 }
 
 void Grid::sampleVelocities(Particles::Ptr p)
 {
-    LOG_OUTPUT("Sampling velocities to grid from particles.");
+    LOG_DEBUG("Sampling velocities to grid from particles.");
     _reset();
-    size_t i,j;
-    float tx,ty;
-    for (int idx = 0; idx < p->numParticles(); ++idx) {
-        _u.bary(p->pos(idx).x, p->pos(idx).y, i, j, tx, ty);
-        _accumulate(_u, _uSum, _uWeights, p->vel(idx).x, i, j, tx, ty);
-        _v.bary(p->pos(idx).x, p->pos(idx).y, i, j, tx, ty);
-        _accumulate(_v, _vSum, _vWeights, p->vel(idx).y, i, j, tx, ty);
+    if (_parallelSampling) {
+        _sampleVelocitiesParallel(p);
+    } else {
+        _sampleVelocitiesSerial(p);
     }
     _u.divide(_uSum);
     _v.divide(_vSum);
 }
 
+void Grid::_sampleVelocitiesSerial(Particles::Ptr p)
+{
+    for (int idx = 0; idx < p->numParticles(); ++idx) {
+        _accumulateParticle(p->pos(idx), p->vel(idx));
+    }
+}
+
+void Grid::_sampleVelocitiesParallel(Particles::Ptr p)
+{
+    // A particle in cell column c scatters into face columns c-1 to c+1, so
+    // strips of at least two columns never write to the same faces as every
+    // other strip. Even strips run in parallel first, then the odd ones.
+    // The strips don't depend on the thread count and the particles are
+    // visited in cell index order, so the sums are the same for any number
+    // of threads.
+    const int stripWidth = 4;
+    const int nx = _v.nx();
+    const int ny = _u.ny();
+    const int numStrips = (nx + stripWidth - 1) / stripWidth;
+    p->updateCellIndex(nx, ny, _u.dx());
+    const int * particles = p->cellParticles();
+
+    for (int color = 0; color < 2; ++color) {
+#pragma omp parallel for schedule(dynamic)
+        for (int s = color; s < numStrips; s += 2) {
+            const int begin = p->cellStart(s * stripWidth, 0);
+            const int end = p->cellStart(std::min(nx, (s + 1) * stripWidth), 0);
+            for (int k = begin; k < end; ++k) {
+                const int idx = particles[k];
+                _accumulateParticle(p->pos(idx), p->vel(idx));
+            }
+        }
+    }
+}
+
+void Grid::_accumulateParticle(const Vec2f & pos, const Vec2f & vel)
+{
+    size_t i,j;
+    float tx,ty;
+    _u.bary(pos.x, pos.y, i, j, tx, ty);
+    _accumulate(_u, _uSum, _uWeights, vel.x, i, j, tx, ty);
+    _v.bary(pos.x, pos.y, i, j, tx, ty);
+    _accumulate(_v, _vSum, _vWeights, vel.y, i, j, tx, ty);
+}
+
 void Grid::applyGravity(const Vec2f & g, float dt)
 {
-    LOG_OUTPUT("Applying gravity.");
+    LOG_DEBUG("Applying gravity.");
     _u.add(g.x * dt);
     _v.add(g.y * dt);
 }
 
 float Grid::CFL() const
 {
-    LOG_OUTPUT("Computing CFL condition.");
+    LOG_DEBUG("Computing CFL condition.");
     float x = sqr(_u.infNorm()) + sqr(_v.infNorm());
     if (x < 1e-16){
         x = 1e-16;
@@ -47,7 +129,12 @@ float Grid::CFL() const
 
 void Grid::extrapolateVelocities(FluidSDF::Ptr f, int numSweepIterations)
 {
-    LOG_OUTPUT("Extrapolating velocities outside the fluid.");
+    LOG_DEBUG("Extrapolating velocities outside the fluid.");
+    if (_bandExtrapolation) {
+        _extrapolateBand(_u, _uWeights, *f.ptr(), 1, 0);
+        _extrapolateBand(_v, _vWeights, *f.ptr(), 0, 1);
+        return;
+    }
     for (int i = 0; i < numSweepIterations; ++i) {
         _sweep<RIGHT, true>(f, true, true);
         _sweep<RIGHT, true>(f, true, false);
@@ -65,7 +152,7 @@ void Grid::pressureProjection(const Array2f & p,
                               FluidSDF::Ptr f,
                               float dt)
 {
-    LOG_OUTPUT("Pressure projection on to grid velocities.");
+    LOG_DEBUG("Pressure projection on to grid velocities.");
     float scale = dt / p.dx();
     float theta;
     _u.reset();
@@ -91,7 +178,11 @@ void Grid::pressureProjection(const Array2f & p,
 
 void Grid::enforceBoundaryConditions(SolidSDF::Ptr s)
 {
-    LOG_OUTPUT("Enforcing boundary conditions on grid velocities.");
+    LOG_DEBUG("Enforcing boundary conditions on grid velocities.");
+    if (s->version() != _solidVersion) {
+        _updateSolidNormals(*s.ptr());
+        _solidVersion = s->version();
+    }
     _uSum.reset();
     _vSum.reset();
         
@@ -99,8 +190,8 @@ void Grid::enforceBoundaryConditions(SolidSDF::Ptr s)
         for (int j = 0; j < _u.ny(); ++j) {
             if (_uWeights.face<LEFT>(i,j) < 0) {
                 const Vec2f pos = _uWeights.pos<LEFT>(i,j);
-                Vec2f gradient = s->gradient(pos);
-                gradient.normalize();
+                Vec2f gradient(_uNormalX.face<LEFT>(i,j),
+                               _uNormalY.face<LEFT>(i,j));
                 const Vec2f vel(_u.face<LEFT>(i,j), _v.bilerp(pos));
                 _uSum.face<LEFT>(i,j) = vel.x - gradient.dot(vel);
             } else {
@@ -112,8 +203,8 @@ void Grid::enforceBoundaryConditions(SolidSDF::Ptr s)
         for (int j = 1; j < _v.ny(); ++j) {
             if (_vWeights.face<BOTTOM>(i,j) < 0) {
                 const Vec2f pos = _vWeights.pos<BOTTOM>(i,j);
-                Vec2f gradient = s->gradient(pos);
-                gradient.normalize();
+                Vec2f gradient(_vNormalX.face<BOTTOM>(i,j),
+                               _vNormalY.face<BOTTOM>(i,j));
                 const Vec2f vel(_u.bilerp(pos), _v.face<BOTTOM>(i,j));
                 _vSum.face<BOTTOM>(i,j) = vel.y - gradient.dot(vel);
             } else {
@@ -126,21 +217,55 @@ void Grid::enforceBoundaryConditions(SolidSDF::Ptr s)
     _v.swap(_vSum);
 }
 
+void Grid::_updateSolidNormals(const SolidSDF & s)
+{
+    LOG_DEBUG("Updating solid normals on grid faces.");
+    for (int i = 1; i < _u.nx(); ++i) {
+        for (int j = 0; j < _u.ny(); ++j) {
+            Vec2f gradient = s.gradient(_uWeights.pos<LEFT>(i,j));
+            gradient.normalize();
+            _uNormalX.face<LEFT>(i,j) = gradient.x;
+            _uNormalY.face<LEFT>(i,j) = gradient.y;
+        }
+    }
+    for (int i = 0; i < _v.nx(); ++i) {
+        for (int j = 1; j < _v.ny(); ++j) {
+            Vec2f gradient = s.gradient(_vWeights.pos<BOTTOM>(i,j));
+            gradient.normalize();
+            _vNormalX.face<BOTTOM>(i,j) = gradient.x;
+            _vNormalY.face<BOTTOM>(i,j) = gradient.y;
+        }
+    }
+}
+
 template<Faces T_FACE, bool T_U>
 void Grid::_sweep(FluidSDF::Ptr f, bool upsweepX, bool upsweepY)
 {
-    const int i0 = upsweepX ? 0 : _u.nx() - 1;
-    const int i1 = upsweepX ? _u.nx() : -1;
-    const int j0 = upsweepY ? 0 : _u.ny() - 1;
-    const int j1 = upsweepY ? _u.ny() : -1;
-    const int di = i0 < i1 ? 1 : -1;
-    const int dj = j0 < j1 ? 1 : -1;
-    for (int j = j0; j != j1; j += dj) {
-        for (int i = i0; i != i1; i += di) {
+    const FluidSDF & fluid = *f.ptr();
+    wavefront(0, _u.nx(), 0, _u.ny(), WAVEFRONT_TILE, !upsweepX, !upsweepY,
+              [&](int i0, int i1, int j0, int j1) {
+                  _sweepTile<T_FACE, T_U>(fluid, i0, i1, j0, j1,
+                                          upsweepX, upsweepY);
+              });
+}
+
+template<Faces T_FACE, bool T_U>
+void Grid::_sweepTile(const FluidSDF & f,
+                      int i0, int i1, int j0, int j1,
+                      bool upsweepX, bool upsweepY)
+{
+    const int di = upsweepX ? 1 : -1;
+    const int dj = upsweepY ? 1 : -1;
+    const int iBegin = upsweepX ? i0 : i1 - 1;
+    const int iEnd = upsweepX ? i1 : i0 - 1;
+    const int jBegin = upsweepY ? j0 : j1 - 1;
+    const int jEnd = upsweepY ? j1 : j0 - 1;
+    for (int j = jBegin; j != jEnd; j += dj) {
+        for (int i = iBegin; i != iEnd; i += di) {
             if (T_U ? _uWeights.face<T_FACE>(i,j) :
                       _vWeights.face<T_FACE>(i,j)) {
                 const Vec2f &p =T_U ? _u.pos<T_FACE>(i,j) : _v.pos<T_FACE>(i,j);
-                const Vec2f grad = f->gradient(p);
+                const Vec2f grad = f.gradient(p);
                 // Only interested in upwinding. If any of the derivates is
                 // negative it means its propegating in the wrong direction
                 if (grad.x < 0.0f || grad.y < 0.0f) {
@@ -164,6 +289,91 @@ void Grid::_sweep(FluidSDF::Ptr f, bool upsweepX, bool upsweepY)
     }
 }
 
+template <typename T_ARRAY>
+void Grid::_extrapolateBand(T_ARRAY & vel,
+                            const T_ARRAY & weights,
+                            const FluidSDF & f,
+                            int di,
+                            int dj)
+{
+    // nx() and ny() of a face array count cells, not faces
+    const int nx = vel.nx() + di;
+    const int ny = vel.ny() + dj;
+    const Array2f & phi = f.phi();
+    _layer.assign(nx * ny, -1);
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            if (!weights(i,j)) {
+                continue;
+            }
+            const bool fluidA = i - di >= 0 && j - dj >= 0 &&
+                    phi(i - di, j - dj) < 0;
+            const bool fluidB = i < phi.nx() && j < phi.ny() && phi(i,j) < 0;
+            if (fluidA || fluidB) {
+                _layer[j + ny * i] = 0;
+            }
+        }
+    }
+
+    // The first frontier is every unknown face next to a known one, in
+    // index order so the result doesn't depend on the thread count
+    _frontier.clear();
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            const int idx = j + ny * i;
+            if (_layer[idx] < 0 &&
+                ((i > 0 && !_layer[idx - ny]) ||
+                 (i < nx - 1 && !_layer[idx + ny]) ||
+                 (j > 0 && !_layer[idx - 1]) ||
+                 (j < ny - 1 && !_layer[idx + 1]))) {
+                _layer[idx] = 1;
+                _frontier.push_back(idx);
+            }
+        }
+    }
+
+    float * v = vel.data();
+    for (int layer = 1; layer <= _numExtrapolationLayers; ++layer) {
+        // Only faces of earlier layers are read, so the frontier can be
+        // updated in any order
+        const int n = _frontier.size();
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < n; ++k) {
+            const int idx = _frontier[k];
+            int neighbours[4];
+            faceNeighbours(idx, nx, ny, neighbours);
+            float sum = 0.0f;
+            int count = 0;
+            for (int m = 0; m < 4; ++m) {
+                const int nb = neighbours[m];
+                if (nb >= 0 && _layer[nb] >= 0 && _layer[nb] < layer) {
+                    sum += v[nb];
+                    ++count;
+                }
+            }
+            v[idx] = sum / count;
+        }
+        if (layer == _numExtrapolationLayers) {
+            break;
+        }
+
+        _nextFrontier.clear();
+        for (int k = 0; k < n; ++k) {
+            const int idx = _frontier[k];
+            int neighbours[4];
+            faceNeighbours(idx, nx, ny, neighbours);
+            for (int m = 0; m < 4; ++m) {
+                const int nb = neighbours[m];
+                if (nb >= 0 && _layer[nb] < 0) {
+                    _layer[nb] = layer + 1;
+                    _nextFrontier.push_back(nb);
+                }
+            }
+        }
+        _frontier.swap(_nextFrontier);
+    }
+}
+
 template <typename T_ARRAY>
 void Grid::_accumulate(T_ARRAY & array,
                        T_ARRAY & sum,
@@ -4,6 +4,7 @@
 #include "ptr.h"
 #include "particles.h"
 #include "sdf.h"
+#include <vector>
 
 class Grid : public SmartPtrInterface<Grid>
 {
@@ -28,6 +29,10 @@ class Grid : public SmartPtrInterface<Grid>
     const FaceArray2Xf & uWeights() const { return _uWeights;}
     const FaceArray2Yf & v() const { return _v;}
     const FaceArray2Yf & vWeights() const { return _vWeights;}
+
+    // Velocities and weights, for checkpoints
+    void writeState(std::ostream & out) const;
+    bool readState(std::istream & in);
     
   protected:
     FaceArray2Xf _u;
@@ -37,15 +42,54 @@ class Grid : public SmartPtrInterface<Grid>
     FaceArray2Yf _v;
     FaceArray2Yf _vSum;    
     FaceArray2Yf _vWeights;
+
+    bool _parallelSampling;
+
+    // Band extrapolation. A face's layer is 0 if it is known, -1 if it
+    // hasn't been reached, otherwise the number of faces out from the fluid.
+    bool _bandExtrapolation;
+    int _numExtrapolationLayers;
+    std::vector<int> _layer;
+    std::vector<int> _frontier;
+    std::vector<int> _nextFrontier;
+
+    // Solid normals at the faces, rebuilt when the solid changes
+    FaceArray2Xf _uNormalX;
+    FaceArray2Xf _uNormalY;
+    FaceArray2Yf _vNormalX;
+    FaceArray2Yf _vNormalY;
+    unsigned int _solidVersion;
     
     Grid(Settings::Ptr s);
     Grid();
     Grid(const Grid &);
     void operator=(const Grid&);
 
+    void _updateSolidNormals(const SolidSDF & s);
+
+    // One extrapolation sweep, in parallel tiles (wavefront)
     template<Faces T_FACE, bool T_U>
     void _sweep(FluidSDF::Ptr f, bool upsweepX, bool upsweepY);
 
+    template<Faces T_FACE, bool T_U>
+    void _sweepTile(const FluidSDF & f,
+                    int i0, int i1, int j0, int j1,
+                    bool upsweepX, bool upsweepY);
+
+    /**
+        Extrapolates from the known faces, those with particles next to a
+        fluid cell, out through numExtrapolationLayers layers of faces. A
+        face in layer k gets the average of its neighbours in the layers
+        before it. The cells on either side of face (i,j) are (i-di,j-dj)
+        and (i,j).
+    */
+    template <typename T_ARRAY>
+    void _extrapolateBand(T_ARRAY & vel,
+                          const T_ARRAY & weights,
+                          const FluidSDF & f,
+                          int di,
+                          int dj);
+
     template <typename T_ARRAY>
     void _accumulate(T_ARRAY & array,
                      T_ARRAY & sum,
@@ -56,6 +100,12 @@ class Grid : public SmartPtrInterface<Grid>
                      float tx,
                      float ty);
 
+    void _sampleVelocitiesSerial(Particles::Ptr p);
+
+    void _sampleVelocitiesParallel(Particles::Ptr p);
+
+    void _accumulateParticle(const Vec2f & pos, const Vec2f & vel);
+
     void _reset();
 
     bool _theta(float w, float phiA, float phiB, float & theta)
@@ -0,0 +1,197 @@
+#include "interpolate.h"
+#include "simd.h"
+
+#ifdef FLIP2D_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+// Raw description of a face array. The sample point is shifted by (ox,oy)
+// index units so that both face directions share the same clamping rule as
+// FaceArray2::bary: i in [0, nx-2] and tx in [0, 1].
+struct Lattice
+{
+    const float * data;
+    int nx;
+    int ny;
+    float dx;
+    float ox;
+    float oy;
+};
+
+template<typename T_ARRAY>
+void bilerpScalar(const T_ARRAY & a,
+                  const float * x,
+                  const float * y,
+                  float * out,
+                  int n)
+{
+    for (int k = 0; k < n; ++k) {
+        out[k] = a.bilerp(x[k], y[k]);
+    }
+}
+
+#ifdef FLIP2D_X86_SIMD
+
+__attribute__((target("avx2")))
+int bilerpAVX2(const Lattice & l,
+               const float * x,
+               const float * y,
+               float * out,
+               int n)
+{
+    const __m256 dx = _mm256_set1_ps(l.dx);
+    const __m256 ox = _mm256_set1_ps(l.ox);
+    const __m256 oy = _mm256_set1_ps(l.oy);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 xMax = _mm256_set1_ps(l.nx - 1);
+    const __m256 yMax = _mm256_set1_ps(l.ny - 1);
+    const __m256 iMax = _mm256_set1_ps(l.nx - 2);
+    const __m256 jMax = _mm256_set1_ps(l.ny - 2);
+    const __m256i ny = _mm256_set1_epi32(l.ny);
+    const __m256i ny1 = _mm256_set1_epi32(l.ny + 1);
+    const __m256i iOne = _mm256_set1_epi32(1);
+
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 fx = _mm256_sub_ps(_mm256_div_ps(_mm256_loadu_ps(x + k), dx), ox);
+        __m256 fy = _mm256_sub_ps(_mm256_div_ps(_mm256_loadu_ps(y + k), dx), oy);
+        fx = _mm256_min_ps(_mm256_max_ps(fx, zero), xMax);
+        fy = _mm256_min_ps(_mm256_max_ps(fy, zero), yMax);
+        const __m256 fi = _mm256_min_ps(_mm256_floor_ps(fx), iMax);
+        const __m256 fj = _mm256_min_ps(_mm256_floor_ps(fy), jMax);
+        const __m256 tx = _mm256_sub_ps(fx, fi);
+        const __m256 ty = _mm256_sub_ps(fy, fj);
+
+        const __m256i idx = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_cvttps_epi32(fi), ny),
+            _mm256_cvttps_epi32(fj));
+        const __m256 a00 = _mm256_i32gather_ps(l.data, idx, 4);
+        const __m256 a01 = _mm256_i32gather_ps(l.data,
+                                               _mm256_add_epi32(idx, iOne), 4);
+        const __m256 a10 = _mm256_i32gather_ps(l.data,
+                                               _mm256_add_epi32(idx, ny), 4);
+        const __m256 a11 = _mm256_i32gather_ps(l.data,
+                                               _mm256_add_epi32(idx, ny1), 4);
+
+        // Same operation order as Array2::bilerp
+        const __m256 sx = _mm256_sub_ps(one, tx);
+        const __m256 sy = _mm256_sub_ps(one, ty);
+        const __m256 left = _mm256_add_ps(_mm256_mul_ps(sy, a00),
+                                          _mm256_mul_ps(ty, a01));
+        const __m256 right = _mm256_add_ps(_mm256_mul_ps(sy, a10),
+                                           _mm256_mul_ps(ty, a11));
+        _mm256_storeu_ps(out + k, _mm256_add_ps(_mm256_mul_ps(sx, left),
+                                                _mm256_mul_ps(tx, right)));
+    }
+    return k;
+}
+
+__attribute__((target("avx512f")))
+int bilerpAVX512(const Lattice & l,
+                 const float * x,
+                 const float * y,
+                 float * out,
+                 int n)
+{
+    const __m512 dx = _mm512_set1_ps(l.dx);
+    const __m512 ox = _mm512_set1_ps(l.ox);
+    const __m512 oy = _mm512_set1_ps(l.oy);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 xMax = _mm512_set1_ps(l.nx - 1);
+    const __m512 yMax = _mm512_set1_ps(l.ny - 1);
+    const __m512 iMax = _mm512_set1_ps(l.nx - 2);
+    const __m512 jMax = _mm512_set1_ps(l.ny - 2);
+    const __m512i ny = _mm512_set1_epi32(l.ny);
+    const __m512i ny1 = _mm512_set1_epi32(l.ny + 1);
+    const __m512i iOne = _mm512_set1_epi32(1);
+
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m512 fx = _mm512_sub_ps(_mm512_div_ps(_mm512_loadu_ps(x + k), dx), ox);
+        __m512 fy = _mm512_sub_ps(_mm512_div_ps(_mm512_loadu_ps(y + k), dx), oy);
+        fx = _mm512_min_ps(_mm512_max_ps(fx, zero), xMax);
+        fy = _mm512_min_ps(_mm512_max_ps(fy, zero), yMax);
+        const __m512 fi = _mm512_min_ps(
+            _mm512_roundscale_ps(fx, _MM_FROUND_TO_NEG_INF), iMax);
+        const __m512 fj = _mm512_min_ps(
+            _mm512_roundscale_ps(fy, _MM_FROUND_TO_NEG_INF), jMax);
+        const __m512 tx = _mm512_sub_ps(fx, fi);
+        const __m512 ty = _mm512_sub_ps(fy, fj);
+
+        const __m512i idx = _mm512_add_epi32(
+            _mm512_mullo_epi32(_mm512_cvttps_epi32(fi), ny),
+            _mm512_cvttps_epi32(fj));
+        const __m512 a00 = _mm512_i32gather_ps(idx, l.data, 4);
+        const __m512 a01 = _mm512_i32gather_ps(_mm512_add_epi32(idx, iOne),
+                                               l.data, 4);
+        const __m512 a10 = _mm512_i32gather_ps(_mm512_add_epi32(idx, ny),
+                                               l.data, 4);
+        const __m512 a11 = _mm512_i32gather_ps(_mm512_add_epi32(idx, ny1),
+                                               l.data, 4);
+
+        const __m512 sx = _mm512_sub_ps(one, tx);
+        const __m512 sy = _mm512_sub_ps(one, ty);
+        const __m512 left = _mm512_add_ps(_mm512_mul_ps(sy, a00),
+                                          _mm512_mul_ps(ty, a01));
+        const __m512 right = _mm512_add_ps(_mm512_mul_ps(sy, a10),
+                                           _mm512_mul_ps(ty, a11));
+        _mm512_storeu_ps(out + k, _mm512_add_ps(_mm512_mul_ps(sx, left),
+                                                _mm512_mul_ps(tx, right)));
+    }
+    return k;
+}
+
+#endif
+
+template<typename T_ARRAY>
+void bilerpDispatch(const T_ARRAY & a,
+                    float ox,
+                    float oy,
+                    const float * x,
+                    const float * y,
+                    float * out,
+                    int n)
+{
+    int k = 0;
+#ifdef FLIP2D_X86_SIMD
+    const Array2f & raw = a;
+    const Lattice l = { raw.data(),
+                        static_cast<int>(raw.nx()),
+                        static_cast<int>(raw.ny()),
+                        raw.dx(),
+                        ox,
+                        oy };
+    if (simdLevel() >= SIMD_AVX512) {
+        k = bilerpAVX512(l, x, y, out, n);
+    } else if (simdLevel() >= SIMD_AVX2) {
+        k = bilerpAVX2(l, x, y, out, n);
+    }
+#endif
+    // Remainder, or everything when there is no vector unit to use
+    bilerpScalar(a, x + k, y + k, out + k, n - k);
+}
+
+}
+
+void bilerp(const FaceArray2Xf & u,
+            const float * x,
+            const float * y,
+            float * out,
+            int n)
+{
+    bilerpDispatch(u, 0.0f, 0.5f, x, y, out, n);
+}
+
+void bilerp(const FaceArray2Yf & v,
+            const float * x,
+            const float * y,
+            float * out,
+            int n)
+{
+    bilerpDispatch(v, 0.5f, 0.0f, x, y, out, n);
+}
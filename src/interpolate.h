@@ -0,0 +1,23 @@
+#ifndef INTERPOLATE_H_
+#define INTERPOLATE_H_
+
+#include "array.h"
+
+/**
+    Bilinearly samples a face array at n positions given as separate x and y
+    arrays. The result is bit-identical to calling FaceArray2::bilerp for
+    every position, but uses AVX2/AVX-512 when the CPU supports it.
+*/
+void bilerp(const FaceArray2Xf & u,
+            const float * x,
+            const float * y,
+            float * out,
+            int n);
+
+void bilerp(const FaceArray2Yf & v,
+            const float * x,
+            const float * y,
+            float * out,
+            int n);
+
+#endif
@@ -0,0 +1,288 @@
+#include "laplace.h"
+#include "simd.h"
+
+#ifdef FLIP2D_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+enum Op
+{
+    MULT,       // y = Ax
+    RESIDUAL,   // y = b - Ax
+    RELAX       // y = (b - (A - D)x) / D
+};
+
+struct Kernel
+{
+    const SparseLaplacianMatrix<float> & A;
+    const Array2f & x;
+    const Array2f & b;
+    const Array2f & mask;
+    Array2f & y;
+    int parity;
+};
+
+// Raw pointers to column i of every array, the matrix entries of cell j
+// are center[j], left[j], right[j], plusJ[j - 1] (bottom) and plusJ[j] (top)
+struct Column
+{
+    const float * center;
+    const float * left;
+    const float * right;
+    const float * plusJ;
+    const float * xLeft;
+    const float * x;
+    const float * xRight;
+    const float * b;
+    const float * mask;
+    float * y;
+};
+
+// Any cell, the boundaries included
+template<Op T_OP>
+void cell(const Kernel & k, int i, int j)
+{
+    if (T_OP == RELAX) {
+        if (k.parity >= 0 && (i + j) % 2 != k.parity) {
+            return;
+        }
+        const float center = k.A.value<CENTER>(i,j);
+        if (k.mask(i,j) < 0 && center) {
+            k.y(i,j) = (k.b(i,j) - k.A.multNeighbors(k.x,i,j)) / center;
+        }
+    } else if (k.mask(i,j) < 0) {
+        const float ax = k.A.mult(k.x,i,j);
+        k.y(i,j) = T_OP == RESIDUAL ? k.b(i,j) - ax : ax;
+    } else {
+        k.y(i,j) = 0;
+    }
+}
+
+// Interior cells j0 <= j < j1 of a column, without the boundary checks of
+// SparseLaplacianMatrix::mult but in the same operation order. A
+// non-negative parity updates every other cell, starting at j0 for 0.
+template<Op T_OP>
+void columnScalar(const Column & c, int j0, int j1, int parity)
+{
+    for (int j = j0; j < j1; ++j) {
+        const float sum = c.left[j] * c.xLeft[j] + c.right[j] * c.xRight[j] +
+                c.plusJ[j - 1] * c.x[j - 1] + c.plusJ[j] * c.x[j + 1];
+        if (T_OP == RELAX) {
+            if ((parity < 0 || (j - j0) % 2 == parity) &&
+                c.mask[j] < 0 && c.center[j]) {
+                c.y[j] = (c.b[j] - sum) / c.center[j];
+            }
+        } else if (c.mask[j] < 0) {
+            const float ax = c.center[j] * c.x[j] + sum;
+            c.y[j] = T_OP == RESIDUAL ? c.b[j] - ax : ax;
+        } else {
+            c.y[j] = 0;
+        }
+    }
+}
+
+#ifdef FLIP2D_X86_SIMD
+
+// Vectorized columnScalar, returns the first cell not done
+template<Op T_OP>
+__attribute__((target("avx2")))
+int columnAVX2(const Column & c, int j0, int j1, int parity)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    // Lanes updated by a red-black sweep, chosen by the parity of j0
+    const __m256 even = _mm256_castsi256_ps(
+        _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0));
+    const __m256 lanes = parity < 0 ? _mm256_castsi256_ps(
+            _mm256_set1_epi32(-1)) : parity == 0 ? even :
+            _mm256_andnot_ps(even, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+
+    int j = j0;
+    for (; j + 8 <= j1; j += 8) {
+        __m256 sum = _mm256_add_ps(
+            _mm256_mul_ps(_mm256_loadu_ps(c.left + j),
+                          _mm256_loadu_ps(c.xLeft + j)),
+            _mm256_mul_ps(_mm256_loadu_ps(c.right + j),
+                          _mm256_loadu_ps(c.xRight + j)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(c.plusJ + j - 1),
+                                               _mm256_loadu_ps(c.x + j - 1)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(c.plusJ + j),
+                                               _mm256_loadu_ps(c.x + j + 1)));
+        const __m256 center = _mm256_loadu_ps(c.center + j);
+        const __m256 fluid = _mm256_cmp_ps(_mm256_loadu_ps(c.mask + j), zero,
+                                           _CMP_LT_OQ);
+        if (T_OP == RELAX) {
+            const __m256 p = _mm256_div_ps(
+                _mm256_sub_ps(_mm256_loadu_ps(c.b + j), sum), center);
+            const __m256 update = _mm256_and_ps(
+                _mm256_and_ps(fluid, lanes),
+                _mm256_cmp_ps(center, zero, _CMP_NEQ_UQ));
+            // Masked store, the other color may be read by other threads
+            _mm256_maskstore_ps(c.y + j, _mm256_castps_si256(update), p);
+        } else {
+            __m256 ax = _mm256_add_ps(
+                _mm256_mul_ps(center, _mm256_loadu_ps(c.x + j)), sum);
+            if (T_OP == RESIDUAL) {
+                ax = _mm256_sub_ps(_mm256_loadu_ps(c.b + j), ax);
+            }
+            _mm256_storeu_ps(c.y + j, _mm256_and_ps(fluid, ax));
+        }
+    }
+    return j;
+}
+
+template<Op T_OP>
+__attribute__((target("avx512f")))
+int columnAVX512(const Column & c, int j0, int j1, int parity)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __mmask16 lanes = parity < 0 ? 0xFFFF : parity == 0 ? 0x5555 :
+            0xAAAA;
+
+    int j = j0;
+    for (; j + 16 <= j1; j += 16) {
+        __m512 sum = _mm512_add_ps(
+            _mm512_mul_ps(_mm512_loadu_ps(c.left + j),
+                          _mm512_loadu_ps(c.xLeft + j)),
+            _mm512_mul_ps(_mm512_loadu_ps(c.right + j),
+                          _mm512_loadu_ps(c.xRight + j)));
+        sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(c.plusJ + j - 1),
+                                               _mm512_loadu_ps(c.x + j - 1)));
+        sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(c.plusJ + j),
+                                               _mm512_loadu_ps(c.x + j + 1)));
+        const __m512 center = _mm512_loadu_ps(c.center + j);
+        const __mmask16 fluid = _mm512_cmp_ps_mask(
+            _mm512_loadu_ps(c.mask + j), zero, _CMP_LT_OQ);
+        if (T_OP == RELAX) {
+            const __m512 p = _mm512_div_ps(
+                _mm512_sub_ps(_mm512_loadu_ps(c.b + j), sum), center);
+            const __mmask16 update = fluid & lanes &
+                    _mm512_cmp_ps_mask(center, zero, _CMP_NEQ_UQ);
+            _mm512_mask_storeu_ps(c.y + j, update, p);
+        } else {
+            __m512 ax = _mm512_add_ps(
+                _mm512_mul_ps(center, _mm512_loadu_ps(c.x + j)), sum);
+            if (T_OP == RESIDUAL) {
+                ax = _mm512_sub_ps(_mm512_loadu_ps(c.b + j), ax);
+            }
+            _mm512_storeu_ps(c.y + j, _mm512_maskz_mov_ps(fluid, ax));
+        }
+    }
+    return j;
+}
+
+#endif
+
+template<Op T_OP>
+void column(const Kernel & k, int i, SimdLevel level)
+{
+    const int nx = k.y.nx();
+    const int ny = k.y.ny();
+    if (i == 0 || i == nx - 1 || ny < 3) {
+        for (int j = 0; j < ny; ++j) {
+            cell<T_OP>(k, i, j);
+        }
+        return;
+    }
+
+    // Peel the bottom and top boundary cells, the rest has all neighbours
+    cell<T_OP>(k, i, 0);
+    const size_t offset = static_cast<size_t>(ny) * i;
+    const Column c = { k.A.diagonal().data() + offset,
+                       k.A.plusI().data() + offset - ny,
+                       k.A.plusI().data() + offset,
+                       k.A.plusJ().data() + offset,
+                       k.x.data() + offset - ny,
+                       k.x.data() + offset,
+                       k.x.data() + offset + ny,
+                       k.b.data() + offset,
+                       k.mask.data() + offset,
+                       k.y.data() + offset };
+    // Relative to j = 1, the vector loops advance by an even number of cells
+    const int parity = k.parity < 0 ? -1 : (k.parity + i + 1) % 2;
+    int j = 1;
+#ifdef FLIP2D_X86_SIMD
+    if (level >= SIMD_AVX512) {
+        j = columnAVX512<T_OP>(c, j, ny - 1, parity);
+    } else if (level >= SIMD_AVX2) {
+        j = columnAVX2<T_OP>(c, j, ny - 1, parity);
+    }
+#endif
+    columnScalar<T_OP>(c, j, ny - 1, parity);
+    cell<T_OP>(k, i, ny - 1);
+}
+
+template<Op T_OP>
+void run(const Kernel & k)
+{
+    const SimdLevel level = simdLevel();
+    const int nx = k.y.nx();
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        column<T_OP>(k, i, level);
+    }
+}
+
+}
+
+void multLaplace(const SparseLaplacianMatrix<float> & A,
+                 const Array2f & x,
+                 const Array2f & mask,
+                 Array2f & y)
+{
+    const Kernel k = { A, x, y, mask, y, -1 };
+    run<MULT>(k);
+}
+
+float multLaplaceDot(const SparseLaplacianMatrix<float> & A,
+                     const Array2f & x,
+                     const Array2f & mask,
+                     Array2f & y,
+                     std::vector<float> & columnSums)
+{
+    const Kernel k = { A, x, y, mask, y, -1 };
+    const SimdLevel level = simdLevel();
+    const int nx = y.nx();
+    const int ny = y.ny();
+    columnSums.resize(nx);
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        column<MULT>(k, i, level);
+        // The column was just written and is still in cache
+        const float * xi = x.data() + static_cast<size_t>(ny) * i;
+        const float * yi = y.data() + static_cast<size_t>(ny) * i;
+        float sum = 0;
+        for (int j = 0; j < ny; ++j) {
+            sum += xi[j] * yi[j];
+        }
+        columnSums[i] = sum;
+    }
+    float dot = 0;
+    for (int i = 0; i < nx; ++i) {
+        dot += columnSums[i];
+    }
+    return dot;
+}
+
+void residualLaplace(const SparseLaplacianMatrix<float> & A,
+                     const Array2f & x,
+                     const Array2f & b,
+                     const Array2f & mask,
+                     Array2f & r)
+{
+    const Kernel k = { A, x, b, mask, r, -1 };
+    run<RESIDUAL>(k);
+}
+
+void relaxLaplace(const SparseLaplacianMatrix<float> & A,
+                  const Array2f & b,
+                  const Array2f & mask,
+                  const Array2f & pFrom,
+                  Array2f & p,
+                  int parity)
+{
+    const Kernel k = { A, pFrom, b, mask, p, parity };
+    run<RELAX>(k);
+}
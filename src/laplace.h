@@ -0,0 +1,56 @@
+#ifndef LAPLACE_H_
+#define LAPLACE_H_
+
+#include "array.h"
+#include "sparse.h"
+#include <vector>
+
+/**
+    Whole-array kernels for the 5-point Laplacian. The cells on the domain
+    boundary are handled in peeled scalar loops, the interior of every
+    column with AVX2/AVX-512 when the CPU supports it. The results are
+    bit-identical to SparseLaplacianMatrix::mult and multNeighbors cell by
+    cell, for every SIMD level and number of threads.
+
+    Cells are fluid where mask is negative.
+*/
+
+// y = Ax on the fluid cells, 0 elsewhere
+void multLaplace(const SparseLaplacianMatrix<float> & A,
+                 const Array2f & x,
+                 const Array2f & mask,
+                 Array2f & y);
+
+/**
+    Same as multLaplace, and returns x.y. Every column is summed on its own
+    and the column sums in order, so the result doesn't depend on the
+    number of threads. columnSums is scratch space.
+*/
+float multLaplaceDot(const SparseLaplacianMatrix<float> & A,
+                     const Array2f & x,
+                     const Array2f & mask,
+                     Array2f & y,
+                     std::vector<float> & columnSums);
+
+// r = b - Ax on the fluid cells, 0 elsewhere
+void residualLaplace(const SparseLaplacianMatrix<float> & A,
+                     const Array2f & x,
+                     const Array2f & b,
+                     const Array2f & mask,
+                     Array2f & r);
+
+/**
+    p = (b - (A - D)pFrom) / D on the fluid cells with a nonzero diagonal D,
+    the other cells keep their value. With parity 0 or 1 only the cells
+    where (i + j) % 2 == parity are updated, and pFrom may be p, which is a
+    red (0) or black (1) Gauss-Seidel half sweep. A negative parity updates
+    every cell, a Jacobi iteration.
+*/
+void relaxLaplace(const SparseLaplacianMatrix<float> & A,
+                  const Array2f & b,
+                  const Array2f & mask,
+                  const Array2f & pFrom,
+                  Array2f & p,
+                  int parity);
+
+#endif
@@ -1,111 +1,225 @@
 #ifndef LOG_H_
 #define LOG_H_
 
+#include "ring.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+
+// Severity levels. Messages above FLIP2D_LOG_LEVEL are compiled out, messages
+// above the runtime level (Log::setLevel) are skipped before formatting.
+#define FLIP2D_LOG_ERROR 0
+#define FLIP2D_LOG_OUTPUT 1
+#define FLIP2D_LOG_DEBUG 2
+
+#ifndef FLIP2D_LOG_LEVEL
+#ifdef NDEBUG
+#define FLIP2D_LOG_LEVEL FLIP2D_LOG_OUTPUT
+#else
+#define FLIP2D_LOG_LEVEL FLIP2D_LOG_DEBUG
+#endif
+#endif
+
+#define FLIP2D_LOG(level, timestamp, args)                              \
+    do {                                                                \
+        if ((level) <= FLIP2D_LOG_LEVEL &&                              \
+            Log::instance().enabled(level)) {                           \
+            std::ostringstream flip2DLogStream_;                        \
+            flip2DLogStream_ << args;                                   \
+            Log::instance().push(level, timestamp,                      \
+                                 flip2DLogStream_.str());               \
+        }                                                               \
+    } while (0)
 
-inline std::string NowTime();
+#define LOG_OUTPUT(args) FLIP2D_LOG(FLIP2D_LOG_OUTPUT, true, args)
 
-#define LOG_OUTPUT(args)                        \
-    Log::instance().stream() << "-- " <<        \
-        NowTime() << ": " << args;              \
-    Log::instance().output();                   \
+#define LOG_OUTPUT_WITHOUT_TIMESTAMPS(args)                             \
+    FLIP2D_LOG(FLIP2D_LOG_OUTPUT, false, args)
 
-#define LOG_OUTPUT_WITHOUT_TIMESTAMPS(args)     \
-    Log::instance().stream() << args;           \
-    Log::instance().output();                   \
+#define LOG_ERROR(args) FLIP2D_LOG(FLIP2D_LOG_ERROR, true, args)
 
-#define LOG_ERROR(args)                         \
-    Log::instance().stream() << "-- " <<        \
-        NowTime() << ": ERROR-- " <<args;       \
-    Log::instance().error();                    \
-    
-#define LOG_DEBUG(args)                         \
-    Log::instance().stream() << args;           \
-    Log::instance().output();                   \
+#define LOG_DEBUG(args) FLIP2D_LOG(FLIP2D_LOG_DEBUG, true, args)
 
+inline std::string FormatTime(std::chrono::system_clock::time_point t);
+
+/**
+    Asynchronous logger. Messages are formatted by the calling thread and
+    handed to a background writer thread through a lock-free ring buffer,
+    so logging never waits on the console or the log file. When the ring is
+    full the message is dropped and counted. Errors are flushed right away.
+*/
 class Log
 {
   public:
-    void error()
+    static Log & instance()
     {
-        std::cout << _ss.str() << std::endl;
-        _logfile << _ss.str() << std::endl;
-        _ss.str("");
-        _ss.clear();
+        static Log instance;
+        return instance;
     }
 
-    void output()
+    void setLevel(int level) { _level.store(level, std::memory_order_relaxed); }
+
+    int level() const { return _level.load(std::memory_order_relaxed); }
+
+    bool enabled(int level) const { return level <= this->level(); }
+
+    void push(int level, bool timestamp, std::string text)
     {
-        std::cerr << _ss.str() << std::endl;
-        _logfile << _ss.str() << std::endl;
-        _ss.str("");
-        _ss.clear();
+        Message m;
+        m.level = level;
+        m.timestamp = timestamp;
+        if (timestamp) {
+            m.time = std::chrono::system_clock::now();
+        }
+        m.text.swap(text);
+        if (_queue.push(m)) {
+            _pushed.fetch_add(1, std::memory_order_release);
+        } else {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (level == FLIP2D_LOG_ERROR) {
+            flush();
+        }
     }
 
-    static Log & instance()
+    // Blocks until every message pushed so far has been written
+    void flush()
     {
-        static Log instance;
-        return instance;
+        const unsigned long target = _pushed.load(std::memory_order_acquire);
+        while (_written.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
     }
 
-    std::stringstream & stream()
+    unsigned long dropped() const
     {
-        return _ss;
+        return _dropped.load(std::memory_order_relaxed);
     }
-    
+
   protected:
-    std::stringstream _ss;
-    std::ofstream _logfile;
+    enum { QUEUE_SIZE = 4096 };
 
-    Log() : _logfile("flip2D_sim.log")
+    struct Message
+    {
+        int level;
+        bool timestamp;
+        std::chrono::system_clock::time_point time;
+        std::string text;
+
+        void swap(Message & m)
+        {
+            std::swap(level, m.level);
+            std::swap(timestamp, m.timestamp);
+            std::swap(time, m.time);
+            text.swap(m.text);
+        }
+    };
+
+    RingBuffer<Message, QUEUE_SIZE> _queue;
+    std::atomic<int> _level;
+    std::atomic<bool> _running;
+    std::atomic<unsigned long> _pushed;
+    std::atomic<unsigned long> _written;
+    std::atomic<unsigned long> _dropped;
+    std::ofstream _logfile;
+    std::thread _writer;
+
+    Log() :
+            _level(FLIP2D_LOG_LEVEL),
+            _running(true),
+            _pushed(0),
+            _written(0),
+            _dropped(0),
+            _logfile("flip2D_sim.log")
     {
         if (!_logfile.is_open()) {
             std::cerr << "Could not create log file" << std::endl;
         }
+        _writer = std::thread(&Log::_run, this);
     }
-    
+
+    ~Log()
+    {
+        _running.store(false, std::memory_order_release);
+        _writer.join();
+    }
+
     Log(const Log &);
     void operator=(const Log &);
-};
 
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+    void _run()
+    {
+        unsigned long reportedDrops = 0;
+        Message m;
+        for (;;) {
+            const bool stop = !_running.load(std::memory_order_acquire);
+            bool wrote = false;
+            while (_queue.pop(m)) {
+                _write(m);
+                _written.fetch_add(1, std::memory_order_release);
+                wrote = true;
+            }
+            const unsigned long drops = dropped();
+            if (drops != reportedDrops) {
+                std::ostringstream ss;
+                ss << "-- " << drops - reportedDrops
+                   << " log messages were dropped.";
+                std::cerr << ss.str() << '\n';
+                _logfile << ss.str() << '\n';
+                reportedDrops = drops;
+                wrote = true;
+            }
+            if (wrote) {
+                _logfile.flush();
+            } else if (stop) {
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
 
-#include <windows.h>
+    void _write(const Message & m)
+    {
+        std::string line;
+        if (m.timestamp) {
+            line = "-- " + FormatTime(m.time) + ": ";
+        }
+        if (m.level == FLIP2D_LOG_ERROR) {
+            line += "ERROR-- ";
+        }
+        line += m.text;
+        if (m.level == FLIP2D_LOG_ERROR) {
+            std::cout << line << std::endl;
+        } else {
+            std::cerr << line << '\n';
+        }
+        _logfile << line << '\n';
+    }
+};
 
-inline std::string NowTime()
+inline std::string FormatTime(std::chrono::system_clock::time_point t)
 {
-    const int MAX_LEN = 200;
-    char buffer[MAX_LEN];
-    if (GetTimeFormatA(LOCALE_USER_DEFAULT, 0, 0, 
-            "HH':'mm':'ss", buffer, MAX_LEN) == 0)
-        return "Error in NowTime()";
-
-    char result[100] = {0};
-    static DWORD first = GetTickCount();
-    std::sprintf(result, "%s.%03ld", buffer, (long)(GetTickCount() - first) % 1000); 
-    return result;
-}
-
+    const time_t seconds = std::chrono::system_clock::to_time_t(t);
+    const long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            t.time_since_epoch()).count() % 1000;
+    tm r = tm();
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+    localtime_s(&r, &seconds);
 #else
-
-#include <sys/time.h>
-
-inline std::string NowTime()
-{
+    localtime_r(&seconds, &r);
+#endif
     char buffer[11];
-    time_t t;
-    time(&t);
-    tm r = {0};
-    strftime(buffer, sizeof(buffer), "%X", localtime_r(&t, &r));
-    struct timeval tv;
-    gettimeofday(&tv, 0);
+    strftime(buffer, sizeof(buffer), "%X", &r);
     char result[100] = {0};
-    std::sprintf(result, "%s.%03ld", buffer, (long)tv.tv_usec / 1000); 
+    std::snprintf(result, sizeof(result), "%s.%03ld", buffer, ms);
     return result;
 }
 
-#endif //WIN32
-
 #endif
@@ -0,0 +1,88 @@
+#include "mgpcg.h"
+#include "log.h"
+#include "timer.h"
+#include "laplace.h"
+
+MGPCG::MGPCG(Settings::Ptr s) :
+        Multigrid(s, MULTIGRID_PRECONDITIONED_CONJUGATE_GRADIENT),
+        _tol(s->tolerance),
+        _maxIterations(s->maxIterations)
+{
+    _residual.resize(s->nx,s->ny,s->dx);
+    _residualOld.resize(s->nx,s->ny,s->dx);
+    _z.resize(s->nx,s->ny,s->dx);
+    _s.resize(s->nx,s->ny,s->dx);
+}
+
+void MGPCG::solveLinearSystem(FluidSDF::Ptr f, float dt)
+{
+    LOG_DEBUG("Solving the linear system with MGPCG.");
+    Timer timer;
+    _solveIterations = 0;
+    _solveResidual = 0;
+    _solveTime = 0;
+    _residual.copy(PressureSolver::_b);
+    const float bNorm = _residual.infNorm();
+    float tol = _tol * bNorm;
+    if (_initialGuess(f->phi(), dt, _pressure)) {
+        // Residual-based startup, r = b - Ap
+        _applyLaplace(_pressure, _z);
+        _residual.add(_z, -1.0f);
+        LOG_DEBUG("Warm start reduced the initial residual from " << bNorm <<
+                   " to " << _residual.infNorm() << ".");
+    }
+    _solveInitialResidual = _residual.infNorm();
+    if (_solveInitialResidual <= tol) {
+        _solveResidual = _solveInitialResidual;
+        return;
+    }
+
+    _applyPreconditioner();
+    _s.copy(_z);
+    float rho = _z.dot(_residual);
+    if (rho == 0) {
+        return;
+    }
+
+    _solveResidual = _solveInitialResidual;
+    int iter;
+    for (iter = 0; iter < _maxIterations; ++iter) {
+        float alpha = rho / _applyLaplace(_s, _z);
+        _residualOld.copy(_residual);
+        _solveResidual = _residual.cgUpdate(alpha, _s, _z, _pressure);
+        if (_solveResidual <= tol) {
+            break;
+        }
+        _applyPreconditioner();
+        // Polak-Ribiere: beta = z.(r - rOld) / rho
+        float rhoNew = _z.dot(_residual);
+        float beta = (rhoNew - _z.dot(_residualOld)) / rho;
+        _s.scaleAndAdd(beta, _z);
+        rho = rhoNew;
+    }
+
+    _solveIterations = iter;
+    _solveTime = timer.elapsed();
+    if (iter < _maxIterations) {
+        LOG_OUTPUT("MGPCG converged in " << iter << " iterations (" <<
+                   1000 * _solveTime << " ms).");
+    } else {
+        LOG_OUTPUT("MGPCG did not converge with tolerance = " << tol <<
+                   " (" << 1000 * _solveTime << " ms).");
+    }
+    LOG_OUTPUT("The residual norm |r| = " << _solveResidual << ".");
+}
+
+void MGPCG::_applyPreconditioner()
+{
+    // One V-cycle on Az = r from a zero guess
+    _b[_M-1].copy(_residual);
+    _p[_M-1].reset();
+    _VCycle(_M-1);
+    _filter(_fluidPhi[_M-1], _p[_M-1], _z);
+}
+
+float MGPCG::_applyLaplace(const Array2f & x, Array2f & b)
+{
+    return multLaplaceDot(_A[_M-1], x, _fluidPhi[_M-1], b, _columnSums);
+}
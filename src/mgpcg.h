@@ -0,0 +1,40 @@
+#ifndef MGPCG_H_
+#define MGPCG_H_
+
+#include "multigrid.h"
+#include <vector>
+
+/**
+    Conjugate gradient preconditioned with one multigrid V-cycle. The
+    iteration count is close to independent of the resolution, unlike
+    MIC(0). The red-black V-cycle is not exactly symmetric, so the flexible
+    (Polak-Ribiere) form of beta is used.
+*/
+class MGPCG : public Multigrid
+{
+  public:
+    static Ptr create(Settings::Ptr s) { return new MGPCG(s); }
+
+    virtual void solveLinearSystem(FluidSDF::Ptr f, float dt);
+
+  protected:
+    float _tol;
+    int _maxIterations;
+    Array2f _residual;
+    Array2f _residualOld;
+    Array2f _z;
+    Array2f _s;
+    std::vector<float> _columnSums;
+
+    MGPCG(Settings::Ptr s);
+    MGPCG();
+    MGPCG(const MGPCG &);
+    void operator=(const MGPCG &);
+
+    void _applyPreconditioner();
+
+    // b = Ax on the fluid cells, returns x.b
+    float _applyLaplace(const Array2f & x, Array2f & b);
+};
+
+#endif
@@ -1,7 +1,9 @@
 #include "multigrid.h"
 #include "gaussSeidel.h"
 
-Multigrid::Multigrid(Settings::Ptr s) : PressureSolver(s, MULTIGRID)
+Multigrid::Multigrid(Settings::Ptr s, SolverType type) :
+        PressureSolver(s, type),
+        _solidVersion(0)
 {
     _numFullCycles = s->numFullCycles;
     _numVCycles = s->numVCycles;
@@ -31,18 +33,15 @@ void Multigrid::buildLinearSystem(Grid::Ptr grid,
                                   FluidSDF::Ptr fluid,
                                   float dt)
 {
-    // Can optimize this
-    bool isSolidUpdated = true;
-    if (isSolidUpdated) {
-        // Copy values
+    // The solid pyramid and the coarse weights only depend on the solid
+    if (solid->version() != _solidVersion) {
         _solidPhi[_M-1].copy(solid->phi());
-        _uWeights[_M-1].copy(grid->uWeights());
-        _vWeights[_M-1].copy(grid->vWeights());
-
-        //Downsample and re-create weights
         _downsampleSolidPhi();
         _createWeights();
+        _solidVersion = solid->version();
     }
+    _uWeights[_M-1].copy(grid->uWeights());
+    _vWeights[_M-1].copy(grid->vWeights());
 
 
     // Copy and downsample the fluid signed distance field
@@ -67,6 +66,9 @@ void Multigrid::buildLinearSystem(Grid::Ptr grid,
 void Multigrid::solveLinearSystem(FluidSDF::Ptr f, float dt)
 {
     _p.reset();
+    if (_initialGuess(f->phi(), dt, _pressure)) {
+        _p[_M-1].copy(_pressure);
+    }
 
     for (int m = 0; m < _numFullCycles; ++m) {
         _fullCycle();
@@ -79,6 +81,7 @@ void Multigrid::solveLinearSystem(FluidSDF::Ptr f, float dt)
     // Filter out prolong artifacts so theres only pressure values inside
     // the fluid
     _filter(_fluidPhi[_M-1], _p[_M-1], _pressure);
+    _solveIterations = _numFullCycles + _numVCycles;
 }
 
 void Multigrid::_fullCycle()
@@ -226,7 +229,8 @@ void MultigridArray<T_ARRAY>::resize(int nxMax,
     int nx = nxMax;
     int ny = nyMax;
     float dx = dxMax;
-    for (int i = 0; i < levels; ++i) {
+    // The last level is the finest one
+    for (int i = levels - 1; i >= 0; --i) {
         _x[i].resize(nx, ny, dx);
         nx /= 2;
         ny /= 2;
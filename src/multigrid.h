@@ -41,6 +41,7 @@ class Multigrid : public PressureSolver
     int _numVCycles;
     int _numPreSweeps;
     int _numPostSweeps;
+    unsigned int _solidVersion;
 
     MultigridArray<Array2f> _fluidPhi;
     MultigridArray<CornerArray2f> _solidPhi;
@@ -52,7 +53,7 @@ class Multigrid : public PressureSolver
     MultigridArray<Array2f> _r;
     MultigridArray<SparseLaplacianMatrix<float> > _A;
     
-    Multigrid(Settings::Ptr s);
+    Multigrid(Settings::Ptr s, SolverType type = MULTIGRID);
     Multigrid();
     Multigrid(const Multigrid &);
     void operator=(const Multigrid &);
@@ -0,0 +1,40 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+    Thin wrappers around OpenMP so the solver still builds (and runs serially)
+    when the compiler has no OpenMP support.
+*/
+
+inline void setNumThreads(int numThreads)
+{
+#ifdef _OPENMP
+    if (numThreads > 0) {
+        omp_set_num_threads(numThreads);
+    }
+#endif
+}
+
+inline int numThreads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int threadIdx()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#endif
@@ -1,8 +1,17 @@
 #include "particles.h"
 #include "util.h"
 #include "log.h"
+#include "interpolate.h"
+#include "compress.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
-Particles::Particles()
+Particles::Particles() :
+        _cellNx(0),
+        _cellNy(0),
+        _cellDx(0),
+        _cellIndexValid(false)
 {
     
 }
@@ -11,14 +20,17 @@ void Particles::initSphere(const Array2f & solidPhi,
                            const Vec2f & center,
                            float radius,
                            int particlesPerCell,
-                           Vec2f vel)
+                           Vec2f vel,
+                           Random & random)
 {
     LOG_OUTPUT("Initating the fluid as a sphere at " << vel);
     const float r2 = sqr(radius);
     for (int i = 0; i < solidPhi.nx(); ++i) {
         for (int j = 0; j < solidPhi.ny(); ++j) {
             for (int n = 0; n < particlesPerCell; ++n) {
-                const Vec2f offset(random(-0.495, 0.495),random(-0.495, 0.495));
+                const float ox = random.uniform(-0.495, 0.495);
+                const float oy = random.uniform(-0.495, 0.495);
+                const Vec2f offset(ox, oy);
                 const Vec2f pos = solidPhi.pos(i,j) + solidPhi.dx() * offset;
                 const Vec2f d = pos - center;
 
@@ -33,52 +45,322 @@ void Particles::initSphere(const Array2f & solidPhi,
 
 void Particles::addParticle(const Vec2f & pos, Vec2f vel)
 {
-    _pos.push_back(pos);
-    _vel.push_back(vel);
+    _posX.push_back(pos.x);
+    _posY.push_back(pos.y);
+    _velX.push_back(vel.x);
+    _velY.push_back(vel.y);
+    _cellIndexValid = false;
 }
 
 void Particles::addParticles(const std::vector<Vec2f> & pos,
                              const std::vector<Vec2f> & vel)
 {
-    _pos = pos;
-    _vel = vel;
+    assert(pos.size() == vel.size());
+    _posX.resize(pos.size());
+    _posY.resize(pos.size());
+    _velX.resize(vel.size());
+    _velY.resize(vel.size());
+    for (size_t i = 0; i < pos.size(); ++i) {
+        _posX[i] = pos[i].x;
+        _posY[i] = pos[i].y;
+        _velX[i] = vel[i].x;
+        _velY[i] = vel[i].y;
+    }
+    _cellIndexValid = false;
+}
+
+void Particles::updateCellIndex(int nx, int ny, float dx)
+{
+    if (_cellIndexValid && nx == _cellNx && ny == _cellNy && dx == _cellDx) {
+        return;
+    }
+    _cellNx = nx;
+    _cellNy = ny;
+    _cellDx = dx;
+
+    // Counting sort of the particle indices by cell. Particles outside the
+    // grid are put in the closest cell.
+    const int n = numParticles();
+    std::vector<int> cell(n);
+    _cellStart.assign(nx * ny + 1, 0);
+    for (int idx = 0; idx < n; ++idx) {
+        const int i = clamp<int>(_posX[idx] / dx, 0, nx - 1);
+        const int j = clamp<int>(_posY[idx] / dx, 0, ny - 1);
+        cell[idx] = j + ny * i;
+        ++_cellStart[cell[idx] + 1];
+    }
+    for (int c = 0; c < nx * ny; ++c) {
+        _cellStart[c + 1] += _cellStart[c];
+    }
+    std::vector<int> cursor(_cellStart.begin(), _cellStart.end() - 1);
+    _cellParticles.resize(n);
+    for (int idx = 0; idx < n; ++idx) {
+        _cellParticles[cursor[cell[idx]]++] = idx;
+    }
+    _cellIndexValid = true;
+}
+
+void Particles::sortByCell(int nx, int ny, float dx)
+{
+    LOG_DEBUG("Sorting particles by grid cell.");
+    updateCellIndex(nx, ny, dx);
+    AlignedVectorf tmp(numParticles());
+    _permute(_posX, tmp);
+    _permute(_posY, tmp);
+    _permute(_velX, tmp);
+    _permute(_velY, tmp);
+
+    // The particles are now stored in cell order
+    for (int k = 0; k < numParticles(); ++k) {
+        _cellParticles[k] = k;
+    }
+}
+
+void Particles::_permute(AlignedVectorf & x, AlignedVectorf & tmp) const
+{
+    const int n = numParticles();
+#pragma omp parallel for
+    for (int k = 0; k < n; ++k) {
+        tmp[k] = x[_cellParticles[k]];
+    }
+    x.swap(tmp);
 }
 
 void Particles::updateVelocities(const FaceArray2Xf & u, const FaceArray2Yf & v)
 {
-    LOG_OUTPUT("Updating particle velocities from grid.");
-    for(int i = 0; i < _pos.size(); ++i) {
-        _vel[i] = Vec2f(u.bilerp(_pos[i]), v.bilerp(_pos[i]));
+    LOG_DEBUG("Updating particle velocities from grid.");
+    const int n = numParticles();
+    const int numBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for
+    for (int b = 0; b < numBlocks; ++b) {
+        const int i = b * BLOCK_SIZE;
+        const int count = std::min<int>(BLOCK_SIZE, n - i);
+        bilerp(u, &_posX[i], &_posY[i], &_velX[i], count);
+        bilerp(v, &_posX[i], &_posY[i], &_velY[i], count);
     }
 }
 
 void Particles::advect(const FaceArray2Xf & u, const FaceArray2Yf & v, float dt)
 {
-    LOG_OUTPUT("Advecting particles position in the grid velocity field");
-    Vec2f mid;
-    for(int i = 0; i < _pos.size(); ++i) {
-        mid = _pos[i] + 0.5f * dt * Vec2f(u.bilerp(_pos[i]),v.bilerp(_pos[i]));
-        _pos[i] = mid + 0.5f * dt * Vec2f(u.bilerp(mid), v.bilerp(mid));
+    LOG_DEBUG("Advecting particles position in the grid velocity field");
+    const float h = 0.5f * dt;
+    const int n = numParticles();
+    const int numBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for
+    for (int b = 0; b < numBlocks; ++b) {
+        float midX[BLOCK_SIZE];
+        float midY[BLOCK_SIZE];
+        float velX[BLOCK_SIZE];
+        float velY[BLOCK_SIZE];
+        float * x = &_posX[b * BLOCK_SIZE];
+        float * y = &_posY[b * BLOCK_SIZE];
+        const int count = std::min<int>(BLOCK_SIZE, n - b * BLOCK_SIZE);
+
+        // Midpoint method
+        bilerp(u, x, y, velX, count);
+        bilerp(v, x, y, velY, count);
+        for (int k = 0; k < count; ++k) {
+            midX[k] = x[k] + h * velX[k];
+            midY[k] = y[k] + h * velY[k];
+        }
+        bilerp(u, midX, midY, velX, count);
+        bilerp(v, midX, midY, velY, count);
+        for (int k = 0; k < count; ++k) {
+            x[k] = midX[k] + h * velX[k];
+            y[k] = midY[k] + h * velY[k];
+        }
+    }
+    _cellIndexValid = false;
+}
+
+void Particles::copy(const Particles & p)
+{
+    _posX = p._posX;
+    _posY = p._posY;
+    _velX = p._velX;
+    _velY = p._velY;
+    _cellIndexValid = false;
+}
+
+void Particles::write(std::ostream & out) const
+{
+    // The file format stores interleaved Vec2f positions followed by
+    // interleaved Vec2f velocities.
+    int N = numParticles();
+    out.write(reinterpret_cast<const char*>(&N), sizeof(int));
+    _writeInterleaved(out, _posX, _posY);
+    _writeInterleaved(out, _velX, _velY);
+}
+
+void Particles::read(std::istream & in)
+{
+    int N = 0;
+    in.read(reinterpret_cast<char *>(&N), sizeof(int));
+    if (!in.good() || N < 0) {
+        in.setstate(std::ios::failbit);
+        N = 0;
+    }
+    _posX.resize(N);
+    _posY.resize(N);
+    _velX.resize(N);
+    _velY.resize(N);
+    _readInterleaved(in, _posX, _posY);
+    _readInterleaved(in, _velX, _velY);
+    _cellIndexValid = false;
+}
+
+namespace
+{
+
+enum Quantization
+{
+    EXACT = 0,
+    UNSIGNED = 1,
+    SIGNED = 2
+};
+
+/**
+    Quantizes x with the given step, which bounds the error to step / 2.
+    Positions are unsigned in [0, extent], velocities signed. Falls back to
+    the exact float bits if the step is zero or too small for 32 bits.
+*/
+void writeQuantized(std::ostream & out,
+                    const AlignedVectorf & x,
+                    float extent,
+                    float step,
+                    bool isSigned)
+{
+    unsigned char kind = isSigned ? SIGNED : UNSIGNED;
+    if (step <= 0) {
+        kind = EXACT;
+    } else if (!isSigned && extent / step >= 2147483648.0f) {
+        kind = EXACT;
+    } else if (isSigned) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            if (std::fabs(x[i]) / step >= 1073741824.0f) {
+                kind = EXACT;
+                break;
+            }
+        }
+    }
+
+    std::vector<unsigned int> q(x.size());
+    if (kind == EXACT) {
+        step = 0;
+        if (!x.empty()) {
+            memcpy(&q[0], &x[0], sizeof(float) * x.size());
+        }
+    } else if (kind == UNSIGNED) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            q[i] = static_cast<unsigned int>(
+                    std::floor(clamp(x[i], 0.0f, extent) / step + 0.5f));
+        }
+    } else {
+        for (size_t i = 0; i < x.size(); ++i) {
+            q[i] = static_cast<int>(std::floor(x[i] / step + 0.5f));
+        }
+    }
+    out.write(reinterpret_cast<const char*>(&kind), sizeof(kind));
+    out.write(reinterpret_cast<const char*>(&step), sizeof(float));
+    encodeStream(out, q);
+}
+
+bool readQuantized(std::istream & in, AlignedVectorf & x)
+{
+    unsigned char kind;
+    float step;
+    in.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+    in.read(reinterpret_cast<char*>(&step), sizeof(float));
+    std::vector<unsigned int> q;
+    if (!in.good() || !decodeStream(in, q, x.size())) {
+        return false;
+    }
+    if (kind == EXACT) {
+        if (!x.empty()) {
+            memcpy(&x[0], &q[0], sizeof(float) * x.size());
+        }
+    } else if (kind == UNSIGNED) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = q[i] * step;
+        }
+    } else if (kind == SIGNED) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = static_cast<int>(q[i]) * step;
+        }
+    } else {
+        return false;
     }
+    return true;
+}
+
 }
 
-void Particles::write(std::ofstream & out) const
+void Particles::writeCompressed(std::ostream & out,
+                                const Vec2f & extent,
+                                float positionError,
+                                float velocityError) const
 {
     int N = numParticles();
-    int size = sizeof(Vec2f) * N;
     out.write(reinterpret_cast<const char*>(&N), sizeof(int));
-    out.write(reinterpret_cast<const char*>(&_pos[0]), size);
-    out.write(reinterpret_cast<const char*>(&_vel[0]), size);
+    writeQuantized(out, _posX, extent.x, 2 * positionError, false);
+    writeQuantized(out, _posY, extent.y, 2 * positionError, false);
+    const unsigned char hasVelocity = velocityError >= 0;
+    out.write(reinterpret_cast<const char*>(&hasVelocity), 1);
+    if (hasVelocity) {
+        writeQuantized(out, _velX, 0, 2 * velocityError, true);
+        writeQuantized(out, _velY, 0, 2 * velocityError, true);
+    }
 }
 
-void Particles::read(std::ifstream & in)
+bool Particles::readCompressed(std::istream & in)
 {
     int N;
     in.read(reinterpret_cast<char *>(&N), sizeof(int));
-    _pos.resize(N);
-    _vel.resize(N);
-    int size = sizeof(Vec2f) * N;
-    in.read(reinterpret_cast<char*>(&_pos[0]), size);
-    in.read(reinterpret_cast<char*>(&_vel[0]), size);
+    if (!in.good() || N < 0) {
+        return false;
+    }
+    _posX.resize(N);
+    _posY.resize(N);
+    _velX.assign(N, 0.0f);
+    _velY.assign(N, 0.0f);
+    _cellIndexValid = false;
+    if (!readQuantized(in, _posX) || !readQuantized(in, _posY)) {
+        return false;
+    }
+    unsigned char hasVelocity;
+    in.read(reinterpret_cast<char*>(&hasVelocity), 1);
+    if (!in.good()) {
+        return false;
+    }
+    return !hasVelocity ||
+            (readQuantized(in, _velX) && readQuantized(in, _velY));
 }
 
+void Particles::_writeInterleaved(std::ostream & out,
+                                  const AlignedVectorf & x,
+                                  const AlignedVectorf & y) const
+{
+    Vec2f buffer[BLOCK_SIZE];
+    for (size_t i = 0; i < x.size(); i += BLOCK_SIZE) {
+        const size_t count = std::min<size_t>(BLOCK_SIZE, x.size() - i);
+        for (size_t k = 0; k < count; ++k) {
+            buffer[k] = Vec2f(x[i + k], y[i + k]);
+        }
+        out.write(reinterpret_cast<const char*>(buffer), sizeof(Vec2f) * count);
+    }
+}
+
+void Particles::_readInterleaved(std::istream & in,
+                                 AlignedVectorf & x,
+                                 AlignedVectorf & y)
+{
+    Vec2f buffer[BLOCK_SIZE];
+    for (size_t i = 0; i < x.size(); i += BLOCK_SIZE) {
+        const size_t count = std::min<size_t>(BLOCK_SIZE, x.size() - i);
+        in.read(reinterpret_cast<char*>(buffer), sizeof(Vec2f) * count);
+        for (size_t k = 0; k < count; ++k) {
+            x[i + k] = buffer[k].x;
+            y[i + k] = buffer[k].y;
+        }
+    }
+}
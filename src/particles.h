@@ -4,6 +4,8 @@
 #include "ptr.h"
 #include "vec2.h"
 #include "array.h"
+#include "aligned.h"
+#include "random.h"
 #include <fstream>
 
 class Particles : public SmartPtrInterface<Particles>
@@ -17,31 +19,96 @@ class Particles : public SmartPtrInterface<Particles>
                     const Vec2f & center,
                     float radius,
                     int particlesPerCell,
-                    Vec2f vel);
+                    Vec2f vel,
+                    Random & random);
     
     void addParticle(const Vec2f & pos, Vec2f vel = Vec2f());
     void addParticles(const std::vector<Vec2f> & pos,
                       const std::vector<Vec2f> & vel);
     
-    int numParticles() const { return _pos.size(); }
-    const Vec2f & pos(int particleIdx) { return _pos[particleIdx]; }
-    const Vec2f & vel(int particleIdx) { return _vel[particleIdx]; }
+    int numParticles() const { return _posX.size(); }
+    Vec2f pos(int idx) const { return Vec2f(_posX[idx], _posY[idx]); }
+    Vec2f vel(int idx) const { return Vec2f(_velX[idx], _velY[idx]); }
+
+    // Structure of arrays access, 64 byte aligned
+    const float * posX() const { return &_posX[0]; }
+    const float * posY() const { return &_posY[0]; }
+    const float * velX() const { return &_velX[0]; }
+    const float * velY() const { return &_velY[0]; }
+
+    /**
+        Index of the particles binned by grid cell. Cells are ordered like
+        Array2 storage, so the particles of cell (i,j) are
+        cellParticles()[cellStart(i,j)] up to cellStart(i,j) + cellCount(i,j)
+        and a range of cell columns is one contiguous range. The index is
+        rebuilt only if the particles moved since it was last built.
+    */
+    void updateCellIndex(int nx, int ny, float dx);
+    int cellStart(int i, int j) const { return _cellStart[j + _cellNy * i]; }
+    int cellCount(int i, int j) const
+    {
+        return _cellStart[j + _cellNy * i + 1] - _cellStart[j + _cellNy * i];
+    }
+    const int * cellParticles() const { return &_cellParticles[0]; }
+
+    /**
+        Reorders the particle arrays by grid cell (counting sort) so that
+        particles close in space are close in memory.
+    */
+    void sortByCell(int nx, int ny, float dx);
 
     void updateVelocities(const FaceArray2Xf & u, const FaceArray2Yf & v);
     
     void advect(const FaceArray2Xf & u, const FaceArray2Yf & v, float dt);
 
-    void write(std::ofstream & out) const;
+    // Copies the particles of p, used for output snapshots
+    void copy(const Particles & p);
+
+    void write(std::ostream & out) const;
+
+    void read(std::istream & in);
+
+    /**
+        Compressed particle block, see compress.h. Positions are quantized
+        in [0, extent] and velocities around zero with at most the given
+        absolute errors. Returns false on a corrupt block.
+    */
+    void writeCompressed(std::ostream & out,
+                         const Vec2f & extent,
+                         float positionError,
+                         float velocityError) const;
 
-    void read(std::ifstream & in);
+    bool readCompressed(std::istream & in);
 
   protected:
-    std::vector<Vec2f> _pos;
-    std::vector<Vec2f> _vel;
+    // Particles are processed in blocks of this size by the grid transfers
+    enum { BLOCK_SIZE = 256 };
+
+    AlignedVectorf _posX;
+    AlignedVectorf _posY;
+    AlignedVectorf _velX;
+    AlignedVectorf _velY;
+
+    std::vector<int> _cellStart;
+    std::vector<int> _cellParticles;
+    int _cellNx;
+    int _cellNy;
+    float _cellDx;
+    bool _cellIndexValid;
     
     Particles();
     Particles(const Particles &);
     void operator=(const Particles &);
+
+    void _writeInterleaved(std::ostream & out,
+                           const AlignedVectorf & x,
+                           const AlignedVectorf & y) const;
+
+    void _readInterleaved(std::istream & in,
+                          AlignedVectorf & x,
+                          AlignedVectorf & y);
+
+    void _permute(AlignedVectorf & x, AlignedVectorf & tmp) const;
 };
 
 #endif
@@ -1,10 +1,14 @@
 #include "pcg.h"
 #include "log.h"
+#include "timer.h"
+#include "wavefront.h"
+#include "laplace.h"
 
 PCG::PCG(Settings::Ptr s) :
         PressureSolver(s, PRECONDITIONED_CONJUGATE_GRADIENT),
         _tol(s->tolerance),
-        _maxIterations(s->maxIterations)
+        _maxIterations(s->maxIterations),
+        _preconditioner(s->preconditioner)
 {
     _z.resize(s->nx,s->ny,s->dx);
     _s.resize(s->nx,s->ny,s->dx);
@@ -18,15 +22,31 @@ void PCG::buildLinearSystem(Grid::Ptr grid,
                             float dt)
 {
     PressureSolver::buildLinearSystem(grid, solid, fluid,dt);
+    Timer timer;
     _buildIncompleteCholeskyPreconditioner(fluid);
+    LOG_DEBUG("Built the " << preconditionerName(_preconditioner) <<
+               " preconditioner in " << 1000 * timer.elapsed() << " ms.");
 }
 
 void PCG::solveLinearSystem(FluidSDF::Ptr f, float dt)
 {
-    LOG_OUTPUT("Solving the linear system with PCG.");
-    float tol = _tol * _b.infNorm();
-    _pressure.reset();
-    if (_b.infNorm() == 0) {
+    LOG_DEBUG("Solving the linear system with PCG.");
+    Timer timer;
+    _solveIterations = 0;
+    _solveResidual = 0;
+    _solveTime = 0;
+    const float bNorm = _b.infNorm();
+    float tol = _tol * bNorm;
+    if (_initialGuess(f->phi(), dt, _pressure)) {
+        // Residual-based startup, r = b - Ap
+        _applyLaplace(f, _pressure, _z);
+        _b.add(_z, -1.0f);
+        LOG_DEBUG("Warm start reduced the initial residual from " << bNorm <<
+                   " to " << _b.infNorm() << ".");
+    }
+    _solveInitialResidual = _b.infNorm();
+    if (_solveInitialResidual <= tol) {
+        _solveResidual = _solveInitialResidual;
         return;
     }
 
@@ -37,15 +57,18 @@ void PCG::solveLinearSystem(FluidSDF::Ptr f, float dt)
         return;
     }
 
+    _solveResidual = _solveInitialResidual;
     int iter;
     for (iter = 0; iter < _maxIterations; ++iter) {
-        _applyLaplace(f, _s, _z);
-        float alpha = rho / _s.dot(_z);
-        _pressure.add(_s, alpha);
-        _b.add(_z, -alpha);
-        if (_b.infNorm() <= tol) {
-            LOG_OUTPUT("PCG converged in " << iter << " iterations.");
-            LOG_OUTPUT("The residual norm |r| = " << _b.infNorm() << ".");
+        float alpha = rho / _applyLaplace(f, _s, _z);
+        _solveResidual = _b.cgUpdate(alpha, _s, _z, _pressure);
+        if (_solveResidual <= tol) {
+            _solveIterations = iter;
+            _solveTime = timer.elapsed();
+            LOG_OUTPUT("PCG converged in " << iter << " iterations (" <<
+                       1000 * _solveTime << " ms, " <<
+                       preconditionerName(_preconditioner) << ").");
+            LOG_OUTPUT("The residual norm |r| = " << _solveResidual << ".");
             return;
         }
         _applyPreconditioner(f);
@@ -54,30 +77,75 @@ void PCG::solveLinearSystem(FluidSDF::Ptr f, float dt)
         _s.scaleAndAdd(beta, _z);
         rho = rhoNew;
     }
-    LOG_OUTPUT("PCG did not converge with tolerance = " << tol << ".");
-    LOG_OUTPUT("The residual norm |r| = " << _b.infNorm() << ".");
+    _solveIterations = iter;
+    _solveTime = timer.elapsed();
+    LOG_OUTPUT("PCG did not converge with tolerance = " << tol << " (" <<
+               1000 * _solveTime << " ms, " <<
+               preconditionerName(_preconditioner) << ").");
+    LOG_OUTPUT("The residual norm |r| = " << _solveResidual << ".");
+}
+
+const char * PCG::preconditionerName(Settings::Preconditioner p)
+{
+    switch (p) {
+        case Settings::MIC_WAVEFRONT:
+            return "wavefront MIC(0)";
+        case Settings::IC_RED_BLACK:
+            return "red-black IC(0)";
+        default:
+            return "MIC(0)";
+    }
 }
 
 void PCG::_applyPreconditioner(FluidSDF::Ptr f)
 {
+    const FluidSDF & fluid = *f.ptr();
+    if (_preconditioner == Settings::IC_RED_BLACK) {
+        _applyRedBlackPreconditioner(fluid);
+        return;
+    }
+
     _q.reset();
     _z.reset();
+    if (_preconditioner == Settings::MIC_WAVEFRONT) {
+        // Solve Lq = r
+        wavefront(1, _q.nx(), 1, _q.ny(), WAVEFRONT_TILE, false, false,
+                  [&](int i0, int i1, int j0, int j1) {
+                      _forwardSubstitution(fluid, i0, i1, j0, j1);
+                  });
+        // Solve L^Tz = q
+        wavefront(0, _z.nx() - 1, 0, _z.ny() - 1, WAVEFRONT_TILE, true, true,
+                  [&](int i0, int i1, int j0, int j1) {
+                      _backwardSubstitution(fluid, i0, i1, j0, j1);
+                  });
+    } else {
+        _forwardSubstitution(fluid, 1, _q.nx(), 1, _q.ny());
+        _backwardSubstitution(fluid, 0, _z.nx() - 1, 0, _z.ny() - 1);
+    }
+}
+
+void PCG::_forwardSubstitution(const FluidSDF & f,
+                               int i0, int i1, int j0, int j1)
+{
     float t;
-    // Solve Lq = r
-    for (int i = 1; i < _q.nx() ; ++i) {
-        for (int j = 1; j < _q.ny() ; ++j) {
-            if (f->isFluid(i,j)) {
+    for (int i = i0; i < i1; ++i) {
+        for (int j = j0; j < j1; ++j) {
+            if (f.isFluid(i,j)) {
                 t = _b(i,j)- _A.value<LEFT>(i,j) * _precon(i-1,j) * _q(i-1,j)
                            - _A.value<BOTTOM>(i,j) * _precon(i,j-1) * _q(i,j-1);
                 _q(i,j) = t * _precon(i,j);
             }
         }
     }
+}
 
-    // Solve L^Tz = q
-    for (int i = _z.nx() - 2; i != -1; --i) {
-        for (int j = _z.ny() - 2; j != -1; --j) {
-            if (f->isFluid(i,j)) {
+void PCG::_backwardSubstitution(const FluidSDF & f,
+                                int i0, int i1, int j0, int j1)
+{
+    float t;
+    for (int i = i1 - 1; i >= i0; --i) {
+        for (int j = j1 - 1; j >= j0; --j) {
+            if (f.isFluid(i,j)) {
                 t = _q(i,j) - _A.value<RIGHT>(i,j) * _precon(i,j) * _z(i+1,j)
                             - _A.value<TOP>(i,j) * _precon(i,j) * _z(i,j+1);
                 _z(i,j) = t * _precon(i,j);
@@ -86,27 +154,36 @@ void PCG::_applyPreconditioner(FluidSDF::Ptr f)
     }
 }
 
-void PCG::_applyLaplace(FluidSDF::Ptr f, const Array2f x, Array2f & b)
+float PCG::_applyLaplace(FluidSDF::Ptr f, const Array2f & x, Array2f & b)
 {
-    b.reset();
-    for (int i = 0; i < b.nx(); ++i) {
-        for (int j = 0; j < b.ny(); ++j) {
-            if (f->isFluid(i,j)){
-                b(i,j) = _A.mult(x,i,j);
-            }
-        }
-    }
+    return multLaplaceDot(_A, x, f->phi(), b, _columnSums);
 }
 
 void PCG::_buildIncompleteCholeskyPreconditioner(FluidSDF::Ptr f)
+{
+    const FluidSDF & fluid = *f.ptr();
+    _precon.reset();
+    if (_preconditioner == Settings::IC_RED_BLACK) {
+        _buildRedBlackPreconditioner(fluid);
+    } else if (_preconditioner == Settings::MIC_WAVEFRONT) {
+        wavefront(1, _precon.nx(), 1, _precon.ny(), WAVEFRONT_TILE, false, false,
+                  [&](int i0, int i1, int j0, int j1) {
+                      _buildPreconditioner(fluid, i0, i1, j0, j1);
+                  });
+    } else {
+        _buildPreconditioner(fluid, 1, _precon.nx(), 1, _precon.ny());
+    }
+}
+
+void PCG::_buildPreconditioner(const FluidSDF & f,
+                               int i0, int i1, int j0, int j1)
 {
     const float mic = 0.99;
     const float safety = 0.25;
     float e;
-    _precon.reset();
-    for (int i = 1; i < _precon.nx(); ++i) {
-        for (int j = 1; j < _precon.ny(); ++j) {
-            if (f->isFluid(i,j)) {
+    for (int i = i0; i < i1; ++i) {
+        for (int j = j0; j < j1; ++j) {
+            if (f.isFluid(i,j)) {
                 const float a = _A.value<CENTER>(i,j);
                 const float aii = _A.value<LEFT>(i,j);
                 const float aij = _A.value<RIGHT>(i,j-1);
@@ -126,3 +203,119 @@ void PCG::_buildIncompleteCholeskyPreconditioner(FluidSDF::Ptr f)
         }
     }
 }
+
+void PCG::_buildRedBlackPreconditioner(const FluidSDF & f)
+{
+    // With all red cells ((i+j) even) ordered before the black ones, red
+    // cells have no earlier neighbours and black cells only have red ones.
+    // The factorization of each color is then independent per cell.
+    // Plain IC(0) is used: the modified compensation is tuned for the
+    // natural ordering and almost doubles the iteration count here.
+    const float safety = 0.25;
+    const int nx = _precon.nx();
+    const int ny = _precon.ny();
+
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                _precon(i,j) = 1.0 / sqrt(_A.value<CENTER>(i,j) + 1e-6);
+            }
+        }
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 1 - i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                float e = _A.value<CENTER>(i,j);
+                if (i > 0) {
+                    e -= sqr(_A.value<LEFT>(i,j) * _precon(i-1,j));
+                }
+                if (i < nx - 1) {
+                    e -= sqr(_A.value<RIGHT>(i,j) * _precon(i+1,j));
+                }
+                if (j > 0) {
+                    e -= sqr(_A.value<BOTTOM>(i,j) * _precon(i,j-1));
+                }
+                if (j < ny - 1) {
+                    e -= sqr(_A.value<TOP>(i,j) * _precon(i,j+1));
+                }
+                if (e < safety * _A.value<CENTER>(i,j)) {
+                    e = _A.value<CENTER>(i,j);
+                }
+                _precon(i,j) = 1.0 / sqrt(e + 1e-6);
+            }
+        }
+    }
+}
+
+void PCG::_applyRedBlackPreconditioner(const FluidSDF & f)
+{
+    const int nx = _precon.nx();
+    const int ny = _precon.ny();
+    _q.reset();
+    _z.reset();
+
+    // Solve Lq = r, red cells first
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                _q(i,j) = _b(i,j) * _precon(i,j);
+            }
+        }
+    }
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 1 - i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                float t = _b(i,j);
+                if (i > 0) {
+                    t -= _A.value<LEFT>(i,j) * _precon(i-1,j) * _q(i-1,j);
+                }
+                if (i < nx - 1) {
+                    t -= _A.value<RIGHT>(i,j) * _precon(i+1,j) * _q(i+1,j);
+                }
+                if (j > 0) {
+                    t -= _A.value<BOTTOM>(i,j) * _precon(i,j-1) * _q(i,j-1);
+                }
+                if (j < ny - 1) {
+                    t -= _A.value<TOP>(i,j) * _precon(i,j+1) * _q(i,j+1);
+                }
+                _q(i,j) = t * _precon(i,j);
+            }
+        }
+    }
+
+    // Solve L^Tz = q, black cells first
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 1 - i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                _z(i,j) = _q(i,j) * _precon(i,j);
+            }
+        }
+    }
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = i % 2; j < ny; j += 2) {
+            if (f.isFluid(i,j)) {
+                float t = _q(i,j);
+                if (i > 0) {
+                    t -= _A.value<LEFT>(i,j) * _precon(i,j) * _z(i-1,j);
+                }
+                if (i < nx - 1) {
+                    t -= _A.value<RIGHT>(i,j) * _precon(i,j) * _z(i+1,j);
+                }
+                if (j > 0) {
+                    t -= _A.value<BOTTOM>(i,j) * _precon(i,j) * _z(i,j-1);
+                }
+                if (j < ny - 1) {
+                    t -= _A.value<TOP>(i,j) * _precon(i,j) * _z(i,j+1);
+                }
+                _z(i,j) = t * _precon(i,j);
+            }
+        }
+    }
+}
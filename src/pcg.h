@@ -2,6 +2,7 @@
 #define PCG_H_
 
 #include "pressure.h"
+#include <vector>
 
 class PCG : public PressureSolver
 {
@@ -17,14 +18,18 @@ class PCG : public PressureSolver
                                    float dt);
 
     virtual void solveLinearSystem(FluidSDF::Ptr f, float dt);
+
+    static const char * preconditionerName(Settings::Preconditioner p);
     
   protected:
     Array2f _z;
     Array2f _s;
     Array2f _q;
     Array2f _precon;
+    std::vector<float> _columnSums;
     float _tol;
     int _maxIterations;
+    Settings::Preconditioner _preconditioner;
     
     PCG(Settings::Ptr s);
     PCG();
@@ -33,9 +38,26 @@ class PCG : public PressureSolver
 
     void _applyPreconditioner(FluidSDF::Ptr f);
 
-    void _applyLaplace(FluidSDF::Ptr f, const Array2f x, Array2f & b);
+    // b = Ax on the fluid cells, returns x.b
+    float _applyLaplace(FluidSDF::Ptr f, const Array2f & x, Array2f & b);
             
     void _buildIncompleteCholeskyPreconditioner(FluidSDF::Ptr f);
+
+    // MIC(0) in natural ordering, restricted to a range of cells so the
+    // wavefront mode can run it tile by tile
+    void _buildPreconditioner(const FluidSDF & f,
+                              int i0, int i1, int j0, int j1);
+
+    void _forwardSubstitution(const FluidSDF & f,
+                              int i0, int i1, int j0, int j1);
+
+    void _backwardSubstitution(const FluidSDF & f,
+                               int i0, int i1, int j0, int j1);
+
+    // IC(0) in red-black ordering
+    void _buildRedBlackPreconditioner(const FluidSDF & f);
+
+    void _applyRedBlackPreconditioner(const FluidSDF & f);
 };
 
 #endif
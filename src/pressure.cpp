@@ -1,8 +1,16 @@
 #include "pressure.h"
 #include "util.h"
 #include "log.h"
+#include "laplace.h"
 
-PressureSolver::PressureSolver(Settings::Ptr s, SolverType type) : _type(type)
+PressureSolver::PressureSolver(Settings::Ptr s, SolverType type) :
+        _type(type),
+        _solveIterations(0),
+        _solveResidual(0),
+        _solveTime(0),
+        _solveInitialResidual(0),
+        _warmStart(s->warmStart),
+        _lastDt(0)
 {
   _resize(s->nx,s->ny,s->dx);
 }
@@ -12,7 +20,7 @@ void PressureSolver::buildLinearSystem(Grid::Ptr grid,
                                        FluidSDF::Ptr fluid,
                                        float dt)
 {
-    LOG_OUTPUT("Building the linear system for the pressure equation.");
+    LOG_DEBUG("Building the linear system for the pressure equation.");
     _buildLaplace(grid->uWeights(), grid->vWeights(), fluid->phi(), _A, dt);
     _buildRHS(grid->u(),grid->v(),grid->uWeights(),grid->vWeights(),fluid,_b);
 }
@@ -24,40 +32,55 @@ void PressureSolver::_buildLaplace(const FaceArray2Xf & uw,
                                    float dt)
 {
     A.reset();
-    for (int i = 0; i < _pressure.nx(); ++i) {
-        for (int j = 0; j < _pressure.ny(); ++j) {
+    float center, right, top;
+    for (int i = 0; i < phi.nx(); ++i) {
+        for (int j = 0; j < phi.ny(); ++j) {
             if (phi(i,j) < 0) {
-                if (i > 0) {
-                    A.value<CENTER>(i,j) += _laplaceCenter(uw.face<LEFT>(i,j),
-                                                           phi(i,j),
-                                                           phi(i-1,j));
-                }
-                if (j > 0) {
-                    A.value<CENTER>(i,j) += _laplaceCenter(vw.face<BOTTOM>(i,j),
-                                                           phi(i,j),
-                                                           phi(i,j-1));
-                }
+                _laplaceRow(uw, vw, phi, i, j, center, right, top);
+                A.value<CENTER>(i,j) = center;
 
                 // We only have to do it on two faces because of symmetri.
-                if (i < _pressure.nx() - 1) {
-                    A.value<RIGHT>(i,j) = -uw.face<RIGHT>(i,j)*(phi(i+1,j) < 0);
-                    A.value<CENTER>(i,j) += _laplaceCenter(uw.face<RIGHT>(i,j),
-                                                           phi(i,j),
-                                                           phi(i+1,j));
+                if (i < phi.nx() - 1) {
+                    A.value<RIGHT>(i,j) = right;
                 }
-                if (j < _pressure.ny() - 1) {
-                    A.value<TOP>(i,j) = -vw.face<TOP>(i,j) * (phi(i,j+1) < 0);
-                    A.value<CENTER>(i,j) += _laplaceCenter(vw.face<TOP>(i,j),
-                                                           phi(i,j),
-                                                           phi(i,j+1));
+                if (j < phi.ny() - 1) {
+                    A.value<TOP>(i,j) = top;
                 }
             }
         }
     }
-    const float scale = dt / (sqr(_pressure.dx()));
+    const float scale = dt / (sqr(phi.dx()));
     A.multiply(scale);
 }
 
+void PressureSolver::_laplaceRow(const FaceArray2Xf & uw,
+                                 const FaceArray2Yf & vw,
+                                 const Array2f & phi,
+                                 int i,
+                                 int j,
+                                 float & center,
+                                 float & right,
+                                 float & top)
+{
+    center = 0;
+    right = 0;
+    top = 0;
+    if (i > 0) {
+        center += _laplaceCenter(uw.face<LEFT>(i,j), phi(i,j), phi(i-1,j));
+    }
+    if (j > 0) {
+        center += _laplaceCenter(vw.face<BOTTOM>(i,j), phi(i,j), phi(i,j-1));
+    }
+    if (i < phi.nx() - 1) {
+        right = -uw.face<RIGHT>(i,j) * (phi(i+1,j) < 0);
+        center += _laplaceCenter(uw.face<RIGHT>(i,j), phi(i,j), phi(i+1,j));
+    }
+    if (j < phi.ny() - 1) {
+        top = -vw.face<TOP>(i,j) * (phi(i,j+1) < 0);
+        center += _laplaceCenter(vw.face<TOP>(i,j), phi(i,j), phi(i,j+1));
+    }
+}
+
 float PressureSolver::_laplaceCenter(float w, float phiFluid, float phiAir)
 {
     if (phiAir >= 0) {
@@ -98,14 +121,7 @@ void PressureSolver::_computeResidual(const Array2f & phi,
                                       const Array2f & b,
                                       Array2f & r)
 {
-    r.reset();
-    for (int i = 0; i < pressure.nx(); ++i) {
-        for (int j = 0; j < pressure.ny(); ++j) {
-            if (phi(i,j) < 0) {
-                r(i,j) = b(i,j) - A.mult(pressure,i,j);
-            }
-        }
-    }
+    residualLaplace(A, pressure, b, phi, r);
 }
 
 void PressureSolver::_resize(int nx, int ny, float dx)
@@ -114,3 +130,39 @@ void PressureSolver::_resize(int nx, int ny, float dx)
     _b.resize(nx,ny,dx);
     _A.resize(nx,ny,dx);
 }
+
+bool PressureSolver::_initialGuess(const Array2f & phi, float dt, Array2f & p)
+{
+    const bool warm = _warmStart && _lastDt > 0;
+    // The pressure scales with 1/dt for the same divergence
+    const float scale = warm ? _lastDt / dt : 0;
+    _lastDt = dt;
+    if (!warm) {
+        p.reset();
+        return false;
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < p.nx(); ++i) {
+        for (int j = 0; j < p.ny(); ++j) {
+            p(i,j) = phi(i,j) < 0 ? p(i,j) * scale : 0;
+        }
+    }
+    return true;
+}
+
+void PressureSolver::writeState(std::ostream & out) const
+{
+    const int32_t type = _type;
+    out.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    out.write(reinterpret_cast<const char*>(&_lastDt), sizeof(float));
+    _pressure.write(out);
+}
+
+bool PressureSolver::readState(std::istream & in)
+{
+    int32_t type;
+    in.read(reinterpret_cast<char*>(&type), sizeof(type));
+    in.read(reinterpret_cast<char*>(&_lastDt), sizeof(float));
+    return in.good() && type == _type && _pressure.read(in);
+}
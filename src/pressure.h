@@ -14,7 +14,9 @@ class PressureSolver : public SmartPtrInterface<PressureSolver>
 
     enum SolverType
     {
-        JACOBI, GAUSS_SEIDEL, PRECONDITIONED_CONJUGATE_GRADIENT, MULTIGRID
+        JACOBI, GAUSS_SEIDEL, PRECONDITIONED_CONJUGATE_GRADIENT, MULTIGRID,
+        COMPACT_PRECONDITIONED_CONJUGATE_GRADIENT,
+        MULTIGRID_PRECONDITIONED_CONJUGATE_GRADIENT
     };
 
     SolverType type() const { return _type; }
@@ -27,9 +29,25 @@ class PressureSolver : public SmartPtrInterface<PressureSolver>
     virtual void solveLinearSystem(FluidSDF::Ptr f, float dt) = 0;
     
     const Array2f & pressure() const { return _pressure; }
+
+    // Statistics of the last solve
+    int solveIterations() const { return _solveIterations; }
+    float solveResidual() const { return _solveResidual; }
+    double solveTime() const { return _solveTime; }
+    float solveInitialResidual() const { return _solveInitialResidual; }
+
+    // The last pressure and dt, which warm starts the next solve
+    void writeState(std::ostream & out) const;
+    bool readState(std::istream & in);
     
   protected:
     SolverType _type;
+    int _solveIterations;
+    float _solveResidual;
+    double _solveTime;
+    float _solveInitialResidual;
+    bool _warmStart;
+    float _lastDt;
     Array2f _pressure;
     Array2f _b;
     SparseLaplacianMatrix<float> _A;
@@ -45,6 +63,19 @@ class PressureSolver : public SmartPtrInterface<PressureSolver>
                        SparseLaplacianMatrix<float> & A,
                        float dt);
 
+    /**
+        Unscaled Laplacian coefficients of the fluid cell (i,j): the diagonal
+        and the couplings to the RIGHT and TOP neighbours.
+    */
+    void _laplaceRow(const FaceArray2Xf & uWeights,
+                     const FaceArray2Yf & vWeights,
+                     const Array2f & fluidPhi,
+                     int i,
+                     int j,
+                     float & center,
+                     float & right,
+                     float & top);
+
     void _buildRHS(const FaceArray2Xf & u,
                    const FaceArray2Yf & v,
                    const FaceArray2Xf & uWeights,
@@ -58,6 +89,13 @@ class PressureSolver : public SmartPtrInterface<PressureSolver>
                           const Array2f & b,
                           Array2f & r);
 
+    /**
+        Initial guess for the solve. With warm start, the pressure of the
+        previous solve is masked to the current fluid and rescaled by the
+        change in dt, otherwise it is zero. Returns true on a warm start.
+    */
+    bool _initialGuess(const Array2f & fluidPhi, float dt, Array2f & p);
+
     void _resize(int nx, int ny, float dx = 1.0f);
     
     private:
@@ -0,0 +1,39 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+/**
+    Small random number generator (splitmix64) with an explicit state, so
+    the sequence can be saved in checkpoints and resumed exactly. Unlike
+    rand() it gives the same numbers on every platform.
+*/
+class Random
+{
+  public:
+    explicit Random(uint64_t seed = 0) : _state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [min, max)
+    float uniform(float min, float max)
+    {
+        const float t = (next() >> 40) * (1.0f / 16777216.0f);
+        return min + t * (max - min);
+    }
+
+    uint64_t state() const { return _state; }
+
+    void setState(uint64_t state) { _state = state; }
+
+  protected:
+    uint64_t _state;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "render.h"
+#include "sequence.h"
+#include "util.h"
+#include "log.h"
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+
+unsigned char toByte(float c)
+{
+    return static_cast<unsigned char>(clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+Color mix(const Color & a, const Color & b, float t)
+{
+    return Color(a.r + t * (b.r - a.r),
+                 a.g + t * (b.g - a.g),
+                 a.b + t * (b.b - a.b));
+}
+
+void putBigEndian(std::string & out, uint32_t value)
+{
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void writeChunk(std::ostream & out, const char * type, const std::string & data)
+{
+    std::string chunk;
+    putBigEndian(chunk, data.size());
+    chunk.append(type, 4);
+    chunk.append(data);
+    // The CRC covers the type and the data, not the length
+    putBigEndian(chunk, checksum(chunk.data() + 4, chunk.size() - 4));
+    out.write(chunk.data(), chunk.size());
+}
+
+}
+
+Image::Image(int width, int height) :
+        _width(width),
+        _height(height),
+        _rgb(3 * width * height)
+{
+}
+
+void Image::setPixel(int x, int y, const Color & c)
+{
+    unsigned char * p = &_rgb[3 * (x + _width * y)];
+    p[0] = toByte(c.r);
+    p[1] = toByte(c.g);
+    p[2] = toByte(c.b);
+}
+
+bool Image::writePPM(const char * filename) const
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    out << "P6\n" << _width << " " << _height << "\n255\n";
+    out.write(reinterpret_cast<const char *>(&_rgb[0]), _rgb.size());
+    out.close();
+    return !out.fail();
+}
+
+bool Image::writePNG(const char * filename) const
+{
+    std::string header;
+    putBigEndian(header, _width);
+    putBigEndian(header, _height);
+    header.push_back(8);  // Bit depth
+    header.push_back(2);  // RGB
+    header.append(3, '\0');  // Deflate, adaptive filtering, no interlace
+
+    // Every row starts with filter type 0 (none)
+    const size_t row = 3 * _width;
+    std::string raw;
+    raw.reserve((row + 1) * _height);
+    for (int y = 0; y < _height; ++y) {
+        raw.push_back('\0');
+        raw.append(reinterpret_cast<const char *>(&_rgb[row * y]), row);
+    }
+
+    // zlib stream of stored blocks, each at most 65535 bytes
+    std::string data;
+    data.push_back(0x78);
+    data.push_back(0x01);
+    size_t offset = 0;
+    do {
+        const size_t n = std::min<size_t>(raw.size() - offset, 65535);
+        const bool last = offset + n == raw.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back(static_cast<char>(n & 0xFF));
+        data.push_back(static_cast<char>(n >> 8));
+        data.push_back(static_cast<char>(~n & 0xFF));
+        data.push_back(static_cast<char>((~n >> 8) & 0xFF));
+        data.append(raw, offset, n);
+        offset += n;
+    } while (offset < raw.size());
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        a = (a + static_cast<unsigned char>(raw[i])) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(data, (b << 16) | a);
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    const char signature[8] = { '\x89', 'P', 'N', 'G',
+                                 '\r', '\n', '\x1a', '\n' };
+    out.write(signature, sizeof(signature));
+    writeChunk(out, "IHDR", header);
+    writeChunk(out, "IDAT", data);
+    writeChunk(out, "IEND", std::string());
+    out.close();
+    return !out.fail();
+}
+
+bool Image::write(const std::string & filename) const
+{
+    const size_t n = filename.size();
+    const bool png = n >= 4 && filename.compare(n - 4, 4, ".png") == 0;
+    const bool ok = png ? writePNG(filename.c_str()) :
+            writePPM(filename.c_str());
+    if (!ok) {
+        LOG_ERROR("Could not write image " << filename);
+    }
+    return ok;
+}
+
+void renderParticles(const Particles & p,
+                     const Vec2f & extent,
+                     float radius,
+                     const Color & fluid,
+                     const Color & background,
+                     Image & image)
+{
+    const int w = image.width();
+    const int h = image.height();
+    const float sx = w / extent.x;
+    const float sy = h / extent.y;
+    const int reach = static_cast<int>(std::ceil(radius));
+    std::vector<float> coverage(w * h, 0.0f);
+    for (int k = 0; k < p.numParticles(); ++k) {
+        const Vec2f pos = p.pos(k);
+        const float px = pos.x * sx;
+        const float py = h - pos.y * sy;
+        const int cx = static_cast<int>(std::floor(px));
+        const int cy = static_cast<int>(std::floor(py));
+        const int x0 = std::max(0, cx - reach);
+        const int x1 = std::min(w - 1, cx + reach);
+        const int y0 = std::max(0, cy - reach);
+        const int y1 = std::min(h - 1, cy + reach);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                const float dx = x + 0.5f - px;
+                const float dy = y + 0.5f - py;
+                const float d = std::sqrt(dx * dx + dy * dy);
+                if (d < radius) {
+                    coverage[x + w * y] += 1.0f - d / radius;
+                }
+            }
+        }
+    }
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const float t = 1.0f - std::exp(-coverage[x + w * y]);
+            image.setPixel(x, y, mix(background, fluid, t));
+        }
+    }
+}
+
+void renderPhi(const Array2f & phi,
+               const Vec2f & extent,
+               const Color & fluid,
+               const Color & background,
+               Image & image)
+{
+    const int w = image.width();
+    const int h = image.height();
+    const float pixel = extent.x / w;
+    for (int y = 0; y < h; ++y) {
+        const float wy = extent.y * (1.0f - (y + 0.5f) / h);
+        for (int x = 0; x < w; ++x) {
+            const float wx = extent.x * (x + 0.5f) / w;
+            const float d = phi.bilerp(wx, wy) / pixel;
+            const float t = clamp(0.5f - d, 0.0f, 1.0f);
+            image.setPixel(x, y, mix(background, fluid, t));
+        }
+    }
+}
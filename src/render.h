@@ -0,0 +1,76 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include "vec2.h"
+#include "array.h"
+#include "particles.h"
+#include <vector>
+#include <string>
+
+struct Color
+{
+    float r;
+    float g;
+    float b;
+
+    Color(float r, float g, float b) : r(r), g(g), b(b) {}
+};
+
+/**
+    8 bit RGB image for the headless renderer. Row 0 is the top of the
+    image, so y is flipped relative to the simulation.
+*/
+class Image
+{
+  public:
+    Image(int width, int height);
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+
+    const unsigned char * pixel(int x, int y) const
+    {
+        return &_rgb[3 * (x + _width * y)];
+    }
+
+    // Components are clamped to [0, 1]
+    void setPixel(int x, int y, const Color & c);
+
+    // Binary PPM (P6)
+    bool writePPM(const char * filename) const;
+
+    // PNG with uncompressed (stored) deflate blocks, no zlib needed
+    bool writePNG(const char * filename) const;
+
+    // PNG if the filename ends with .png, PPM otherwise
+    bool write(const std::string & filename) const;
+
+  protected:
+    int _width;
+    int _height;
+    std::vector<unsigned char> _rgb;
+};
+
+/**
+    Splats every particle as a cone of the given radius in pixels, and maps
+    the accumulated coverage to the fluid color over the background. The
+    domain [0, extent] fills the image.
+*/
+void renderParticles(const Particles & p,
+                     const Vec2f & extent,
+                     float radius,
+                     const Color & fluid,
+                     const Color & background,
+                     Image & image);
+
+/**
+    Shades the inside (phi < 0) of a level set with the fluid color. The
+    interface is anti-aliased over one pixel.
+*/
+void renderPhi(const Array2f & phi,
+               const Vec2f & extent,
+               const Color & fluid,
+               const Color & background,
+               Image & image);
+
+#endif
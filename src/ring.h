@@ -0,0 +1,87 @@
+#ifndef RING_H_
+#define RING_H_
+
+#include <atomic>
+#include <cstddef>
+
+/**
+    Bounded lock-free multi-producer multi-consumer queue. Each cell carries
+    a sequence number that tells producers and consumers whether it is free,
+    so push and pop never block; they fail instead when the queue is full or
+    empty. T_SIZE must be a power of two.
+*/
+template<typename T, size_t T_SIZE>
+class RingBuffer
+{
+  public:
+    RingBuffer() : _enqueuePos(0), _dequeuePos(0)
+    {
+        for (size_t i = 0; i < T_SIZE; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(T & value)
+    {
+        Cell * cell;
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &_cells[pos & (T_SIZE - 1)];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (dif == 0) {
+                if (_enqueuePos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value.swap(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T & value)
+    {
+        Cell * cell;
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &_cells[pos & (T_SIZE - 1)];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+            if (dif == 0) {
+                if (_dequeuePos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value.swap(cell->value);
+        cell->sequence.store(pos + T_SIZE, std::memory_order_release);
+        return true;
+    }
+
+  protected:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell _cells[T_SIZE];
+    alignas(64) std::atomic<size_t> _enqueuePos;
+    alignas(64) std::atomic<size_t> _dequeuePos;
+
+    RingBuffer(const RingBuffer &);
+    void operator=(const RingBuffer &);
+};
+
+#endif
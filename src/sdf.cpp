@@ -1,9 +1,11 @@
 #include "sdf.h"
 #include "log.h"
+#include "wavefront.h"
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 
-SolidSDF::SolidSDF(Settings::Ptr s)
+SolidSDF::SolidSDF(Settings::Ptr s) : _version(1)
 {
     _phi.resize(s->nx,s->ny,s->dx);
 }
@@ -12,7 +14,7 @@ void SolidSDF::createWeights(const CornerArray2f & phi,
                              FaceArray2Xf & uw,
                              FaceArray2Yf & vw)
 {
-    LOG_OUTPUT("Creating solid/fluid weights for velocities.");
+    LOG_DEBUG("Creating solid/fluid weights for velocities.");
     int iEnd = uw.nx() - 1;
     for (int j = 0; j < uw.ny(); ++j) {
         for (int i = 0; i < uw.nx(); ++i) {
@@ -58,19 +60,43 @@ void SolidSDF::initBoxBoundary(int width)
         ++m;
         x+= 1.0f;
     }
+    markChanged();
 }
 
-FluidSDF::FluidSDF(Settings::Ptr s)
+FluidSDF::FluidSDF(Settings::Ptr s) :
+        _parallelReconstruction(s->useParallelReconstruction),
+        _narrowBand(s->useNarrowBand),
+        _bandWidth(s->narrowBandWidth * s->dx)
 {
     _phi.resize(s->nx,s->ny,s->dx);
     _sum.resize(s->nx,s->ny,s->dx);
     _pAvg.resize(s->nx,s->ny,s->dx);
 }
 
+int FluidSDF::numFluidCells() const
+{
+    int n = 0;
+    for (int i = 0; i < _phi.nx(); ++i) {
+        for (int j = 0; j < _phi.ny(); ++j) {
+            n += isFluid(i,j);
+        }
+    }
+    return n;
+}
+
 void FluidSDF::reconstructSurface(Particles::Ptr particles, float R, float r)
 {
-    LOG_OUTPUT("Reconstructing fluid surface.");
+    LOG_DEBUG("Reconstructing fluid surface.");
     assert(R && r);
+    if (_parallelReconstruction) {
+        _gatherSurface(particles, R, r);
+    } else {
+        _scatterSurface(particles, R, r);
+    }
+}
+
+void FluidSDF::_scatterSurface(Particles::Ptr particles, float R, float r)
+{
     _sum.reset();
     _pAvg.reset();
     
@@ -105,24 +131,89 @@ void FluidSDF::reconstructSurface(Particles::Ptr particles, float R, float r)
     }
 }
 
+void FluidSDF::_gatherSurface(Particles::Ptr particles, float R, float r)
+{
+    const int nx = _phi.nx();
+    const int ny = _phi.ny();
+    particles->updateCellIndex(nx, ny, _phi.dx());
+    const int * index = particles->cellParticles();
+    const float * px = particles->posX();
+    const float * py = particles->posY();
+
+    // A particle in cell c is scattered to cells c-2 to c+1 above, so each
+    // cell gathers from the particles in cells i-1 to i+2. Every cell is
+    // written by one thread only.
+#pragma omp parallel for
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            const Vec2f x = _phi.pos(i,j);
+            float sum = 0;
+            Vec2f pAvg;
+            for (int ci = std::max(0,i-1); ci < std::min(nx,i+3); ++ci) {
+                for (int cj = std::max(0,j-1); cj < std::min(ny,j+3); ++cj) {
+                    const int begin = particles->cellStart(ci,cj);
+                    const int end = begin + particles->cellCount(ci,cj);
+                    for (int k = begin; k < end; ++k) {
+                        const Vec2f p(px[index[k]], py[index[k]]);
+                        const float w = _kernel((p - x).length() / R);
+                        sum += w;
+                        pAvg += w * p;
+                    }
+                }
+            }
+            if (sum > 0) {
+                pAvg *= (1.0f / sum);
+                _phi(i,j) = (x - pAvg).length() - r;
+            } else {
+                _phi(i,j) = _phi.dx() * 1e15;
+            }
+        }
+    }
+}
+
 void FluidSDF::reinitialize(int numSwepIterations)
 {
-    LOG_OUTPUT("Reinitializing fluid SDF with " << numSwepIterations <<
+    if (_narrowBand) {
+        LOG_DEBUG("Reinitializing fluid SDF in a band of " << _bandWidth <<
+                  " with fast marching");
+        _fastMarch();
+        return;
+    }
+    LOG_DEBUG("Reinitializing fluid SDF with " << numSwepIterations <<
                " sweep iterations");
     for (int i = 0; i < numSwepIterations; ++i) {
-        _sweep(1,_phi.nx(), 1,_phi.ny());
-        _sweep(_phi.nx() - 2, -1,_phi.ny() - 2, -1);
-        _sweep(1, _phi.nx(), _phi.ny() - 2, -1);
-        _sweep(_phi.nx()-2, -1, 1, _phi.ny());
+        _sweep(false, false);
+        _sweep(true, true);
+        _sweep(false, true);
+        _sweep(true, false);
     }
 }
 
-void FluidSDF::_sweep(int i0, int i1, int j0, int j1)
+void FluidSDF::_sweep(bool reverseI, bool reverseJ)
+{
+    // The first row and column in the sweep direction have no upwind
+    // neighbour and are skipped
+    const int i0 = reverseI ? 0 : 1;
+    const int i1 = reverseI ? _phi.nx() - 1 : _phi.nx();
+    const int j0 = reverseJ ? 0 : 1;
+    const int j1 = reverseJ ? _phi.ny() - 1 : _phi.ny();
+    wavefront(i0, i1, j0, j1, WAVEFRONT_TILE, reverseI, reverseJ,
+              [&](int ti0, int ti1, int tj0, int tj1) {
+                  _sweepTile(ti0, ti1, tj0, tj1, reverseI, reverseJ);
+              });
+}
+
+void FluidSDF::_sweepTile(int i0, int i1, int j0, int j1,
+                          bool reverseI, bool reverseJ)
 {
-    const int di = i0 < i1 ? 1 : -1;
-    const int dj = j0 < j1 ? 1 : -1;
-    for (int i = i0; i != i1; i+= di) {
-        for (int j = j0; j != j1; j+= dj) {
+    const int di = reverseI ? -1 : 1;
+    const int dj = reverseJ ? -1 : 1;
+    const int iBegin = reverseI ? i1 - 1 : i0;
+    const int iEnd = reverseI ? i0 - 1 : i1;
+    const int jBegin = reverseJ ? j1 - 1 : j0;
+    const int jEnd = reverseJ ? j0 - 1 : j1;
+    for (int i = iBegin; i != iEnd; i+= di) {
+        for (int j = jBegin; j != jEnd; j+= dj) {
             if (!isFluid(i,j)) {
                 _solveEikonal(_phi(i - di,j), _phi(i,j - dj), _phi(i,j));
             }
@@ -130,9 +221,107 @@ void FluidSDF::_sweep(int i0, int i1, int j0, int j1)
     }
 }
 
+/**
+    Fast marching over the air cells, closest first. Like the sweeps, a cell
+    keeps its reconstructed distance if that is smaller, and the fluid cells
+    are not changed. Cells are accepted from a heap until the next one is
+    further than the band width, so the work is proportional to the number
+    of cells in the band rather than the grid.
+*/
+void FluidSDF::_fastMarch()
+{
+    const int nx = _phi.nx();
+    const int ny = _phi.ny();
+    _known.assign(nx * ny, 0);
+    _heap.clear();
+
+    // The fluid cells are known. Clamp the air cells to the band, and seed
+    // the heap with the ones inside it.
+    float * phi = _phi.data();
+    for (int idx = 0; idx < nx * ny; ++idx) {
+        if (phi[idx] < 0) {
+            _known[idx] = 1;
+        } else if (phi[idx] > _bandWidth) {
+            phi[idx] = _bandWidth;
+        }
+    }
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            if (!isFluid(i,j)) {
+                _update(i,j);
+                if (_phi(i,j) < _bandWidth) {
+                    _heap.push_back(std::make_pair(-_phi(i,j), j + ny * i));
+                }
+            }
+        }
+    }
+    std::make_heap(_heap.begin(), _heap.end());
+
+    while (!_heap.empty()) {
+        std::pop_heap(_heap.begin(), _heap.end());
+        const float value = -_heap.back().first;
+        const int idx = _heap.back().second;
+        _heap.pop_back();
+        if (_known[idx] || value != phi[idx]) {
+            continue;  // Stale, the cell was pushed again with a lower value
+        }
+        _known[idx] = 1;
+        const int i = idx / ny;
+        const int j = idx % ny;
+        if (i > 0 && !_known[idx - ny] && _update(i - 1, j)) {
+            _push(i - 1, j);
+        }
+        if (i < nx - 1 && !_known[idx + ny] && _update(i + 1, j)) {
+            _push(i + 1, j);
+        }
+        if (j > 0 && !_known[idx - 1] && _update(i, j - 1)) {
+            _push(i, j - 1);
+        }
+        if (j < ny - 1 && !_known[idx + 1] && _update(i, j + 1)) {
+            _push(i, j + 1);
+        }
+    }
+}
+
+bool FluidSDF::_update(int i, int j)
+{
+    const int nx = _phi.nx();
+    const int ny = _phi.ny();
+    const int idx = j + ny * i;
+    const float far = _phi.dx() * 1e15;
+    float a = far;
+    float b = far;
+    if (i > 0 && _known[idx - ny]) {
+        a = _phi(i - 1, j);
+    }
+    if (i < nx - 1 && _known[idx + ny]) {
+        a = std::min(a, _phi(i + 1, j));
+    }
+    if (j > 0 && _known[idx - 1]) {
+        b = _phi(i, j - 1);
+    }
+    if (j < ny - 1 && _known[idx + 1]) {
+        b = std::min(b, _phi(i, j + 1));
+    }
+    if (a == far && b == far) {
+        return false;
+    }
+    const float old = _phi(i,j);
+    _solveEikonal(a, b, _phi(i,j));
+    return _phi(i,j) < old;
+}
+
+void FluidSDF::_push(int i, int j)
+{
+    if (_phi(i,j) < _bandWidth) {
+        _heap.push_back(std::make_pair(-_phi(i,j), j + _phi.ny() * i));
+        std::push_heap(_heap.begin(), _heap.end());
+    }
+}
+
 void FluidSDF::extrapolateIntoSolid(const CornerArray2f & solid, Array2f & phi)
 {
-    LOG_OUTPUT("Extrapolating fluid surface into solid.");
+    LOG_DEBUG("Extrapolating fluid surface into solid.");
     for (int i = 0; i < phi.nx(); ++i) {
         for (int j = 0; j < phi.ny(); ++j) {
             if (phi(i,j) < 0.5 * phi.dx() && solid.center(i,j) < 0) {
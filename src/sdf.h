@@ -36,9 +36,24 @@ class SolidSDF : public SmartPtrInterface<SolidSDF>
                               FaceArray2Yf & vw);
 
     const CornerArray2f & phi() const { return _phi; } 
+
+    // Incremented whenever the solid changes. Lets users cache data that
+    // only depends on the solid.
+    unsigned int version() const { return _version; }
+
+    void markChanged() { ++_version; }
+
+    void writeState(std::ostream & out) const { _phi.write(out); }
+
+    bool readState(std::istream & in)
+    {
+        markChanged();
+        return _phi.read(in);
+    }
     
   protected:
     CornerArray2f _phi;
+    unsigned int _version;
     
     SolidSDF(Settings::Ptr s);
     SolidSDF();
@@ -67,8 +82,16 @@ class FluidSDF : public SmartPtrInterface<FluidSDF>
     float phi(int i, int j) const { return _phi(i,j); }
     const Array2f & phi() const { return _phi; } 
 
+    int numFluidCells() const;
+
+    void writeState(std::ostream & out) const { _phi.write(out); }
+
+    bool readState(std::istream & in) { return _phi.read(in); }
+
     void reconstructSurface(Particles::Ptr particles, float R, float r);
 
+    // Redistances the air cells. Sweeps the whole grid, or fast marches in
+    // the narrow band if Settings::useNarrowBand is set.
     void reinitialize(int numSwepIterations);
 
     void extrapolateIntoSolid(SolidSDF::Ptr solid);
@@ -79,6 +102,11 @@ class FluidSDF : public SmartPtrInterface<FluidSDF>
     Array2f _phi;
     Array2f _sum;
     Array2<Vec2f> _pAvg;
+    bool _parallelReconstruction;
+    bool _narrowBand;
+    float _bandWidth;
+    std::vector<unsigned char> _known;
+    std::vector<std::pair<float, int> > _heap;
 
     FluidSDF(Settings::Ptr s);
     FluidSDF();
@@ -86,8 +114,25 @@ class FluidSDF : public SmartPtrInterface<FluidSDF>
     void operator=(const FluidSDF &);
 
     float _kernel(float s) const { return max(0.f,s*s*s*(1.0f-s*s)); }
+
+    void _scatterSurface(Particles::Ptr particles, float R, float r);
+
+    void _gatherSurface(Particles::Ptr particles, float R, float r);
     
-    void _sweep(int i0, int i1, int j0, int j1);
+    // One fast sweeping pass, in parallel tiles (wavefront)
+    void _sweep(bool reverseI, bool reverseJ);
+
+    // Sweeps the cells in [i0,i1) x [j0,j1) in the given direction
+    void _sweepTile(int i0, int i1, int j0, int j1,
+                    bool reverseI, bool reverseJ);
+
+    void _fastMarch();
+
+    // Eikonal update of the cell from its known neighbours. Returns true if
+    // the cell got closer.
+    bool _update(int i, int j);
+
+    void _push(int i, int j);
     
     void _solveEikonal(float a, float b, float & phi) const;
 };
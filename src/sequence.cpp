@@ -0,0 +1,375 @@
+#include "sequence.h"
+#include "log.h"
+#include <cstring>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const char MAGIC[4] = { 'F', '2', 'D', 'S' };
+const char RECORD[4] = { 'F', '2', 'D', 'R' };
+const char FOOTER[4] = { 'F', '2', 'D', 'I' };
+const char TRAILER[4] = { 'F', '2', 'D', 'E' };
+const uint32_t VERSION = 1;
+
+// Sizes in the file
+const size_t HEADER_SIZE = 8;
+const size_t RECORD_SIZE = 28;
+const size_t ENTRY_SIZE = 28;
+const size_t TRAILER_SIZE = 16;
+
+struct CRCTable
+{
+    uint32_t values[256];
+
+    CRCTable()
+    {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            values[n] = c;
+        }
+    }
+
+    uint32_t operator[](int i) const { return values[i]; }
+};
+
+template<typename T>
+void put(std::string & buffer, const T & value)
+{
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+T get(const char * & p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+void putRecord(std::string & buffer, const SequenceEntry & e)
+{
+    buffer.assign(RECORD, sizeof(RECORD));
+    put(buffer, static_cast<int32_t>(e.frame));
+    put(buffer, static_cast<int32_t>(e.numParticles));
+    put(buffer, e.length);
+    put(buffer, e.checksum);
+    put(buffer, checksum(buffer.data(), buffer.size()));
+}
+
+// Parses a record header, the offset of e is set by the caller
+bool getRecord(const char * header, SequenceEntry & e)
+{
+    const char * p = header + RECORD_SIZE - sizeof(uint32_t);
+    if (memcmp(header, RECORD, sizeof(RECORD)) ||
+        checksum(header, RECORD_SIZE - sizeof(uint32_t)) != get<uint32_t>(p)) {
+        return false;
+    }
+    p = header + sizeof(RECORD);
+    e.frame = get<int32_t>(p);
+    e.numParticles = get<int32_t>(p);
+    e.length = get<uint64_t>(p);
+    e.checksum = get<uint32_t>(p);
+    return true;
+}
+
+bool readFooter(std::istream & in,
+                uint64_t size,
+                std::vector<SequenceEntry> & index,
+                uint64_t & end)
+{
+    if (size < HEADER_SIZE + 8 + TRAILER_SIZE) {
+        return false;
+    }
+    char trailer[TRAILER_SIZE];
+    in.seekg(size - TRAILER_SIZE);
+    in.read(trailer, TRAILER_SIZE);
+    const char * p = trailer;
+    const uint64_t offset = get<uint64_t>(p);
+    const uint32_t footerChecksum = get<uint32_t>(p);
+    if (!in.good() || memcmp(p, TRAILER, sizeof(TRAILER)) ||
+        offset < HEADER_SIZE || offset > size - TRAILER_SIZE - 8) {
+        return false;
+    }
+
+    std::string footer(size - TRAILER_SIZE - offset, '\0');
+    in.seekg(offset);
+    in.read(&footer[0], footer.size());
+    p = footer.data() + sizeof(FOOTER);
+    const uint32_t count = get<uint32_t>(p);
+    if (!in.good() || memcmp(footer.data(), FOOTER, sizeof(FOOTER)) ||
+        footer.size() != 8 + count * ENTRY_SIZE ||
+        checksum(footer.data(), footer.size()) != footerChecksum) {
+        return false;
+    }
+    index.resize(count);
+    for (uint32_t k = 0; k < count; ++k) {
+        SequenceEntry & e = index[k];
+        e.frame = get<int32_t>(p);
+        e.numParticles = get<int32_t>(p);
+        e.offset = get<uint64_t>(p);
+        e.length = get<uint64_t>(p);
+        e.checksum = get<uint32_t>(p);
+    }
+    end = offset;
+    return true;
+}
+
+// Keeps every record whose header and data pass their checksums
+void scanRecords(std::istream & in,
+                 uint64_t size,
+                 std::vector<SequenceEntry> & index,
+                 uint64_t & end)
+{
+    index.clear();
+    end = HEADER_SIZE;
+    char header[RECORD_SIZE];
+    std::string data;
+    while (end + RECORD_SIZE <= size) {
+        in.clear();
+        in.seekg(end);
+        in.read(header, RECORD_SIZE);
+        SequenceEntry e;
+        if (!in.good() || !getRecord(header, e) ||
+            e.length > size - end - RECORD_SIZE) {
+            break;
+        }
+        data.resize(e.length);
+        in.read(&data[0], e.length);
+        if (!in.good() || checksum(data.data(), data.size()) != e.checksum) {
+            break;
+        }
+        e.offset = end + RECORD_SIZE;
+        index.push_back(e);
+        end = e.offset + e.length;
+    }
+    in.clear();
+}
+
+bool truncateFile(const char * filename, uint64_t size)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+    HANDLE file = CreateFileA(filename, GENERIC_WRITE, 0, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER end;
+    end.QuadPart = size;
+    const bool ok = SetFilePointerEx(file, end, 0, FILE_BEGIN) &&
+            SetEndOfFile(file);
+    CloseHandle(file);
+    return ok;
+#else
+    return truncate(filename, size) == 0;
+#endif
+}
+
+uint64_t fileSize(std::istream & in)
+{
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    return size > 0 ? size : 0;
+}
+
+}
+
+uint32_t checksum(const char * data, size_t size)
+{
+    static const CRCTable table;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        c = table[(c ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+bool readSequenceIndex(std::istream & in,
+                       uint64_t size,
+                       std::vector<SequenceEntry> & index,
+                       uint64_t & end,
+                       bool & recovered)
+{
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0;
+    in.seekg(0, std::ios::beg);
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&version), sizeof(version));
+    if (!in.good() || memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+        version > VERSION) {
+        return false;
+    }
+    recovered = !readFooter(in, size, index, end);
+    if (recovered) {
+        in.clear();
+        scanRecords(in, size, index, end);
+    }
+    return true;
+}
+
+SequenceWriter::SequenceWriter(const char * filename) :
+        _filename(filename),
+        _end(HEADER_SIZE)
+{
+}
+
+SequenceWriter::Ptr SequenceWriter::open(const char * filename)
+{
+    SequenceWriter::Ptr writer = new SequenceWriter(filename);
+    bool recovered = false;
+    uint64_t size = 0;
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        size = in.is_open() ? fileSize(in) : 0;
+        if (size > 0 && !readSequenceIndex(in, size, writer->_index,
+                                           writer->_end, recovered)) {
+            LOG_ERROR(filename << " is not a frame sequence");
+            return 0;
+        }
+    }
+    if (size == 0) {
+        std::ofstream out(filename, std::ios::out | std::ios::binary);
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+        if (!out) {
+            LOG_ERROR("Could not create frame sequence " << filename);
+            return 0;
+        }
+    }
+
+    writer->_file.open(filename, std::ios::in | std::ios::out |
+                       std::ios::binary);
+    if (!writer->_file.is_open()) {
+        LOG_ERROR("Could not open frame sequence " << filename);
+        return 0;
+    }
+    if (recovered) {
+        LOG_OUTPUT("Recovered " << writer->numFrames() <<
+                   " frames from the damaged sequence " << filename);
+        writer->_writeFooter();
+        writer->_file.flush();
+        truncateFile(filename, writer->_file.tellp());
+    }
+    return writer;
+}
+
+bool SequenceWriter::append(int frame,
+                            const std::string & settings,
+                            const Particles & p,
+                            const FrameFormat & format)
+{
+    _buffer.str(std::string());
+    writeFrame(_buffer, settings, p, format);
+    const std::string & data = _buffer.str();
+
+    SequenceEntry e;
+    e.frame = frame;
+    e.numParticles = p.numParticles();
+    e.offset = _end + RECORD_SIZE;
+    e.length = data.size();
+    e.checksum = checksum(data.data(), data.size());
+    std::string record;
+    putRecord(record, e);
+
+    // The record goes over the old footer, the new footer after it
+    _file.seekp(_end);
+    _file.write(record.data(), record.size());
+    _file.write(data.data(), data.size());
+    _file.flush();
+    _index.push_back(e);
+    _end = e.offset + e.length;
+    _writeFooter();
+    _file.flush();
+    if (!_file) {
+        LOG_ERROR("Could not append frame " << frame << " to " << _filename);
+        _file.clear();
+        return false;
+    }
+    return true;
+}
+
+void SequenceWriter::_writeFooter()
+{
+    std::string footer(FOOTER, sizeof(FOOTER));
+    put(footer, static_cast<uint32_t>(_index.size()));
+    for (size_t k = 0; k < _index.size(); ++k) {
+        const SequenceEntry & e = _index[k];
+        put(footer, static_cast<int32_t>(e.frame));
+        put(footer, static_cast<int32_t>(e.numParticles));
+        put(footer, e.offset);
+        put(footer, e.length);
+        put(footer, e.checksum);
+    }
+    const uint32_t footerChecksum = checksum(footer.data(), footer.size());
+    put(footer, _end);
+    put(footer, footerChecksum);
+    footer.append(TRAILER, sizeof(TRAILER));
+    _file.seekp(_end);
+    _file.write(footer.data(), footer.size());
+}
+
+SequenceReader::SequenceReader(const char * filename) :
+        _filename(filename),
+        _file(filename, std::ios::in | std::ios::binary),
+        _recovered(false)
+{
+}
+
+SequenceReader::Ptr SequenceReader::open(const char * filename)
+{
+    SequenceReader::Ptr reader = new SequenceReader(filename);
+    if (!reader->_file.is_open()) {
+        LOG_ERROR("Could not read frame sequence " << filename);
+        return 0;
+    }
+    uint64_t end;
+    if (!readSequenceIndex(reader->_file, fileSize(reader->_file),
+                           reader->_index, end, reader->_recovered)) {
+        LOG_ERROR(filename << " is not a frame sequence");
+        return 0;
+    }
+    if (reader->_recovered) {
+        LOG_OUTPUT("Recovered " << reader->numFrames() <<
+                   " frames from the damaged sequence " << filename);
+    }
+    return reader;
+}
+
+int SequenceReader::find(int frame) const
+{
+    for (int i = numFrames() - 1; i >= 0; --i) {
+        if (_index[i].frame == frame) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool SequenceReader::read(int i, Settings & s, Particles & p)
+{
+    if (i < 0 || i >= numFrames()) {
+        LOG_ERROR(_filename << " has no frame at index " << i);
+        return false;
+    }
+    const SequenceEntry & e = _index[i];
+    _buffer.resize(e.length);
+    _file.clear();
+    _file.seekg(e.offset);
+    _file.read(&_buffer[0], e.length);
+    if (!_file.good() || checksum(_buffer.data(), e.length) != e.checksum) {
+        LOG_ERROR("Corrupt frame " << e.frame << " in " << _filename);
+        return false;
+    }
+    std::istringstream in(_buffer);
+    return readFrame(in, s, p);
+}
@@ -0,0 +1,119 @@
+#ifndef SEQUENCE_H_
+#define SEQUENCE_H_
+
+#include "ptr.h"
+#include "settings.h"
+#include "particles.h"
+#include "frame.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+/**
+    Many frames in one append-only file, instead of one file per frame.
+
+    The file starts with the magic "F2DS" and a version number. Each frame
+    is a record: a header with the frame number, particle count, length and
+    checksums, followed by the frame exactly as writeFrame writes it. After
+    the last record is a footer with an index of all records, and a trailer
+    with the offset of the footer.
+
+    A new record is written over the old footer, and the new footer after
+    it. If the writer dies half way the footer is missing or fails its
+    checksum, and the index is recovered by scanning the records, keeping
+    every complete one.
+*/
+struct SequenceEntry
+{
+    int frame;
+    int numParticles;
+    uint64_t offset;  // Of the frame data, after the record header
+    uint64_t length;
+    uint32_t checksum;
+};
+
+// CRC-32 of a buffer
+uint32_t checksum(const char * data, size_t size);
+
+/**
+    Reads the index of the sequence in, which is size bytes long. Uses the
+    footer if it is intact, otherwise scans the records and sets recovered.
+    end is where the next record goes. Returns false if in is not a sequence.
+*/
+bool readSequenceIndex(std::istream & in,
+                       uint64_t size,
+                       std::vector<SequenceEntry> & index,
+                       uint64_t & end,
+                       bool & recovered);
+
+class SequenceWriter : public SmartPtrInterface<SequenceWriter>
+{
+  public:
+    typedef SmartPtr<SequenceWriter> Ptr;
+
+    // Creates the sequence or appends to it. Returns a null pointer if the
+    // file exists but isn't a sequence, or can't be written.
+    static Ptr open(const char * filename);
+
+    // A frame number that is already in the sequence hides the older one
+    bool append(int frame,
+                const std::string & settings,
+                const Particles & p,
+                const FrameFormat & format);
+
+    const std::string & filename() const { return _filename; }
+
+    int numFrames() const { return _index.size(); }
+
+  protected:
+    std::string _filename;
+    std::fstream _file;
+    std::vector<SequenceEntry> _index;
+    uint64_t _end;
+    std::ostringstream _buffer;
+
+    SequenceWriter(const char * filename);
+    SequenceWriter();
+    SequenceWriter(const SequenceWriter &);
+    void operator=(const SequenceWriter &);
+
+    void _writeFooter();
+};
+
+class SequenceReader : public SmartPtrInterface<SequenceReader>
+{
+  public:
+    typedef SmartPtr<SequenceReader> Ptr;
+
+    // Returns a null pointer if the file can't be read or isn't a sequence
+    static Ptr open(const char * filename);
+
+    int numFrames() const { return _index.size(); }
+
+    const SequenceEntry & entry(int i) const { return _index[i]; }
+
+    // Index of the frame number, -1 if it isn't in the sequence
+    int find(int frame) const;
+
+    // Reads the i:th frame, fails if its checksum doesn't match
+    bool read(int i, Settings & s, Particles & p);
+
+    // True if the footer was lost and the index was scanned
+    bool recovered() const { return _recovered; }
+
+  protected:
+    std::string _filename;
+    std::ifstream _file;
+    std::vector<SequenceEntry> _index;
+    bool _recovered;
+    std::string _buffer;
+
+    SequenceReader(const char * filename);
+    SequenceReader();
+    SequenceReader(const SequenceReader &);
+    void operator=(const SequenceReader &);
+};
+
+#endif
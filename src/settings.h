@@ -12,6 +12,9 @@ class Settings : public SmartPtrInterface<Settings>
 
     static Ptr create() { return new Settings(); }
     
+    // Threading. numThreads <= 0 uses the OpenMP default.
+    int numThreads;
+
     // Resolution and size
     int nx;
     int ny;
@@ -22,19 +25,43 @@ class Settings : public SmartPtrInterface<Settings>
     float initialFluidRadius;
     Vec2f initialVelocity;
     int particlesPerCell;
+    int particleSortInterval;
+    unsigned int seed;
     
     // SDF
     float solidWidth;
     float R;
     float r;
     int numPhiSweepIterations;
+    bool useParallelReconstruction;
+    // Fast marching instead of sweeping, only out to narrowBandWidth cells
+    // from the surface. Cells further out are clamped to the band width.
+    bool useNarrowBand;
+    float narrowBandWidth;
 
     // Grid
     Vec2f gravity;
     int numVelSweepIterations;
+    bool useParallelSampling;
+    // Extrapolate velocities out from the fluid only numExtrapolationLayers
+    // faces deep, instead of sweeping the whole grid. Faces further out keep
+    // whatever they held.
+    bool useBandExtrapolation;
+    int numExtrapolationLayers;
+
+    // Pressure. warmStart starts each solve from the previous pressure.
+    bool warmStart;
     
     // PCG
+    enum Preconditioner
+    {
+        MIC = 0,            // MIC(0), natural ordering, serial
+        MIC_WAVEFRONT = 1,  // Same factorization, tiles solved in wavefronts
+        IC_RED_BLACK = 2    // IC(0) in red-black ordering, fully parallel
+    };
     bool usePCG;
+    Preconditioner preconditioner;
+    bool useCompactSystem;
     float tolerance;
     int maxIterations;
 
@@ -45,6 +72,7 @@ class Settings : public SmartPtrInterface<Settings>
     int numPreSweeps;
     int numPostSweeps;
     int nxMin;
+    bool useMGPCG;      // PCG with one V-cycle as preconditioner
 
     // GaussSeidel;
     bool useGaussSeidel;
@@ -54,7 +82,17 @@ class Settings : public SmartPtrInterface<Settings>
     bool useJacobi;
     int numJacobiIterations;
 
-    void write(std::ofstream & out) const
+    // Output. Frames are written by a background thread with at most this
+    // many frames queued, 0 writes synchronously.
+    int outputQueueDepth;
+    // Compressed frames store positions and velocities quantized so that the
+    // absolute error stays below these bounds. An error of 0 keeps the exact
+    // floats, a negative velocity error drops the velocities.
+    bool compressOutput;
+    float outputPositionError;
+    float outputVelocityError;
+
+    void write(std::ostream & out) const
     {
         _write(out, &nx);
         _write(out, &ny);
@@ -83,7 +121,63 @@ class Settings : public SmartPtrInterface<Settings>
         _write(out, &numJacobiIterations);
     }
 
-    void read(std::ifstream & in)
+    /**
+        Checkpoints store every field. The frame header above only stores
+        the original fields, which keeps old frame files readable.
+    */
+    void writeCheckpoint(std::ostream & out) const
+    {
+        write(out);
+        _write(out, &r);
+        _write(out, &numThreads);
+        _write(out, &particleSortInterval);
+        _write(out, &seed);
+        _write(out, &useParallelReconstruction);
+        _write(out, &useParallelSampling);
+        _write(out, &warmStart);
+        _write(out, &preconditioner);
+        _write(out, &useCompactSystem);
+        _write(out, &useMGPCG);
+        _write(out, &outputQueueDepth);
+        _write(out, &compressOutput);
+        _write(out, &outputPositionError);
+        _write(out, &outputVelocityError);
+        _write(out, &useNarrowBand);
+        _write(out, &narrowBandWidth);
+        _write(out, &useBandExtrapolation);
+        _write(out, &numExtrapolationLayers);
+    }
+
+    // version is the checkpoint version, fields added later keep their
+    // defaults when reading older checkpoints
+    void readCheckpoint(std::istream & in, int version)
+    {
+        read(in);
+        _read(in, &r);
+        _read(in, &numThreads);
+        _read(in, &particleSortInterval);
+        _read(in, &seed);
+        _read(in, &useParallelReconstruction);
+        _read(in, &useParallelSampling);
+        _read(in, &warmStart);
+        _read(in, &preconditioner);
+        _read(in, &useCompactSystem);
+        _read(in, &useMGPCG);
+        _read(in, &outputQueueDepth);
+        _read(in, &compressOutput);
+        _read(in, &outputPositionError);
+        _read(in, &outputVelocityError);
+        if (version >= 2) {
+            _read(in, &useNarrowBand);
+            _read(in, &narrowBandWidth);
+        }
+        if (version >= 3) {
+            _read(in, &useBandExtrapolation);
+            _read(in, &numExtrapolationLayers);
+        }
+    }
+
+    void read(std::istream & in)
     {
         _read(in, &nx);
         _read(in, &ny);
@@ -113,18 +207,35 @@ class Settings : public SmartPtrInterface<Settings>
     }
 
   protected:
-    Settings() {}
+    Settings() :
+            numThreads(0),
+            particleSortInterval(0),
+            seed(1),
+            useParallelReconstruction(false),
+            useNarrowBand(false),
+            narrowBandWidth(5.0f),
+            useParallelSampling(false),
+            useBandExtrapolation(false),
+            numExtrapolationLayers(4),
+            warmStart(false),
+            preconditioner(MIC),
+            useCompactSystem(false),
+            useMGPCG(false),
+            outputQueueDepth(0),
+            compressOutput(false),
+            outputPositionError(0),
+            outputVelocityError(0) {}
     Settings(const Settings &);
     void operator=(const Settings &);
     
     template<typename T>
-    void _read(std::ifstream & in, T * param)
+    void _read(std::istream & in, T * param)
     {
         in.read(reinterpret_cast<char *>(param), sizeof(T));
     }
 
     template<typename T>
-    void _write(std::ofstream & out, T * param) const
+    void _write(std::ostream & out, T * param) const
     {
         out.write(reinterpret_cast<const char*>(param), sizeof(T));
     }
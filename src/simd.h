@@ -0,0 +1,56 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+// Runtime dispatch is only implemented for GCC/Clang on x86. Everything else
+// uses the scalar code paths.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLIP2D_X86_SIMD
+#endif
+
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2
+};
+
+inline SimdLevel & _simdLevelLimit()
+{
+    static SimdLevel limit = SIMD_AVX512;
+    return limit;
+}
+
+inline SimdLevel _detectSimdLevel()
+{
+#ifdef FLIP2D_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+/**
+    Returns the widest instruction set supported by the CPU, capped by
+    setMaxSimdLevel.
+*/
+inline SimdLevel simdLevel()
+{
+    static const SimdLevel detected = _detectSimdLevel();
+    return detected < _simdLevelLimit() ? detected : _simdLevelLimit();
+}
+
+/**
+    Caps the instruction set used by the dispatched kernels. Mostly useful
+    for comparing the vectorized and scalar paths.
+*/
+inline void setMaxSimdLevel(SimdLevel level)
+{
+    _simdLevelLimit() = level;
+}
+
+#endif
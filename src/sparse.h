@@ -73,6 +73,10 @@ class SparseLaplacianMatrix
              (j < input.ny()-1 ? value<TOP>(i,j)* input(i,j+1) : 0);   
     }
 
+    const Array2<T> & diagonal() const { return _Adiag; }
+    const Array2<T> & plusI() const { return _Aplusi; }
+    const Array2<T> & plusJ() const { return _Aplusj; }
+
     void multiply(T rhs)
     {
         _Adiag.multiply(rhs);
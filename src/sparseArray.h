@@ -0,0 +1,480 @@
+#ifndef SPARSE_ARRAY_H_
+#define SPARSE_ARRAY_H_
+
+#include "array.h"
+#include <vector>
+#include <cassert>
+#include <cmath>
+
+/**
+    Array2 for large, mostly empty domains. The domain is split in
+    T_TILE x T_TILE tiles, and a tile is only allocated when one of its
+    values is written. Every value of an unallocated tile is the background.
+
+    Reading through a const array never allocates. The non-const operator()
+    returns a reference and so has to allocate the tile, use get() to read
+    from a non-const array. Allocation isn't thread safe, activate the tiles
+    serially before writing to them in parallel.
+
+    Elementwise operations only visit the allocated tiles.
+*/
+template<typename T, int T_TILE = 8>
+class SparseArray2
+{
+  public:
+    SparseArray2() : _nx(0), _ny(0), _dx(1.0), _ntx(0), _nty(0),
+                     _background(0) {}
+
+    SparseArray2(size_t nx, size_t ny, float dx, T background = 0) :
+            _background(background)
+    {
+        resize(nx, ny, dx);
+    }
+
+    const T & operator()(size_t i, size_t j) const
+    {
+        assert(i < _nx);
+        assert(j < _ny);
+        const std::vector<T> & tile = _tiles[_tile(i,j)];
+        return tile.empty() ? _background : tile[_local(i,j)];
+    }
+
+    T & operator()(size_t i, size_t j)
+    {
+        assert(i < _nx);
+        assert(j < _ny);
+        std::vector<T> & tile = _tiles[_tile(i,j)];
+        if (tile.empty()) {
+            _allocate(tile);
+        }
+        return tile[_local(i,j)];
+    }
+
+    T get(size_t i, size_t j) const
+    {
+        return (*this)(i,j);
+    }
+
+    // Allocates the tile of (i,j) without changing any value
+    void activate(size_t i, size_t j)
+    {
+        std::vector<T> & tile = _tiles[_tile(i,j)];
+        if (tile.empty()) {
+            _allocate(tile);
+        }
+    }
+
+    bool isActive(size_t i, size_t j) const
+    {
+        return !_tiles[_tile(i,j)].empty();
+    }
+
+    Vec2f pos(size_t i, size_t j) const
+    {
+        return _dx * Vec2<T>(i + 0.5, j + 0.5);
+    }
+
+    void bary(float x,
+              float y,
+              size_t & i,
+              size_t & j,
+              float & tx,
+              float & ty) const
+    {
+        // Scale from world coordinates to index coordinates
+        x/= _dx;
+        y/= _dx;
+
+        if (x < 0.5) {
+            i = 0;
+            tx = 0;
+        } else if (x > _nx - 0.5) {
+            i = _nx - 2;
+            tx = 1;
+        } else {
+            i = floorf(x - 0.5);
+            tx = x - 0.5 - i;
+        }
+
+        if (y < 0.5) {
+            j = 0;
+            ty = 0;
+        } else if (y > _ny - 0.5) {
+            j = _ny - 2;
+            ty = 1;
+        } else {
+            j = floorf(y - 0.5);
+            ty = y - 0.5 - j;
+        }
+    }
+
+    T bilerp(const Vec2f & pos) const
+    {
+        return bilerp(pos.x, pos.y);
+    }
+
+    T bilerp(float x, float y) const
+    {
+        size_t i, j;
+        float tx, ty;
+        bary(x, y, i, j, tx, ty);
+        return bilerp(i,j,tx,ty);
+    }
+
+    T bilerp(size_t i, size_t j, float tx, float ty) const
+    {
+        return (1-tx) * ((1-ty) * get(i,j) +
+               ty * get(i,j+1)) +
+               tx * ((1-ty) * get(i+1,j) +
+               ty * get(i+1,j+1));
+    }
+
+    // Frees every tile, all values become 0
+    void reset()
+    {
+        set(0);
+    }
+
+    // Frees every tile, all values become value
+    void set(T value)
+    {
+        _background = value;
+        for (size_t t = 0; t < _tiles.size(); ++t) {
+            std::vector<T>().swap(_tiles[t]);
+        }
+    }
+
+    void resize(size_t nx, size_t ny, float dx = 1.0)
+    {
+        _nx = nx;
+        _ny = ny;
+        _dx = dx;
+        _ntx = (nx + T_TILE - 1) / T_TILE;
+        _nty = (ny + T_TILE - 1) / T_TILE;
+        _tiles.clear();
+        _tiles.resize(_ntx * _nty);
+    }
+
+    // Frees the tiles where every value equals the background
+    void prune()
+    {
+        for (size_t t = 0; t < _tiles.size(); ++t) {
+            std::vector<T> & tile = _tiles[t];
+            bool empty = true;
+            for (size_t k = 0; k < tile.size() && empty; ++k) {
+                empty = tile[k] == _background;
+            }
+            if (empty) {
+                std::vector<T>().swap(tile);
+            }
+        }
+    }
+
+    // Only allocates the tiles of src with a value other than the
+    // background
+    void copy(const Array2<T> & src)
+    {
+        assert(src.nx() == _nx && src.ny() == _ny);
+        set(_background);
+        for (size_t i = 0; i < _nx; ++i) {
+            for (size_t j = 0; j < _ny; ++j) {
+                if (src(i,j) != _background) {
+                    (*this)(i,j) = src(i,j);
+                }
+            }
+        }
+    }
+
+    void copyTo(Array2<T> & dst) const
+    {
+        assert(dst.nx() == _nx && dst.ny() == _ny);
+        for (size_t i = 0; i < _nx; ++i) {
+            for (size_t j = 0; j < _ny; ++j) {
+                dst(i,j) = get(i,j);
+            }
+        }
+    }
+
+    void swap(SparseArray2 & src)
+    {
+        _tiles.swap(src._tiles);
+        std::swap(_background, src._background);
+    }
+
+    /**
+        Calls f(i0, i1, j0, j1) for every allocated tile, the index ranges
+        are half open and clipped to the array.
+    */
+    template<typename F>
+    void forEachTile(F f) const
+    {
+        for (size_t ti = 0; ti < _ntx; ++ti) {
+            for (size_t tj = 0; tj < _nty; ++tj) {
+                if (!_tiles[tj + _nty * ti].empty()) {
+                    f(ti * T_TILE, std::min(_nx, (ti + 1) * T_TILE),
+                      tj * T_TILE, std::min(_ny, (tj + 1) * T_TILE));
+                }
+            }
+        }
+    }
+
+    // The tiles rhs has allocated are allocated here too
+    void add(const SparseArray2 & rhs, T scale = 1.0)
+    {
+        assert(rhs._tiles.size() == _tiles.size());
+        const T background = rhs._background * scale;
+        for (size_t t = 0; t < _tiles.size(); ++t) {
+            const std::vector<T> & src = rhs._tiles[t];
+            std::vector<T> & dst = _tiles[t];
+            if (src.empty()) {
+                for (size_t k = 0; k < dst.size(); ++k) {
+                    dst[k] += background;
+                }
+                continue;
+            }
+            if (dst.empty()) {
+                _allocate(dst);
+            }
+            for (size_t k = 0; k < dst.size(); ++k) {
+                dst[k] += src[k] * scale;
+            }
+        }
+        _background += background;
+    }
+
+    void multiply(T rhs)
+    {
+        for (size_t t = 0; t < _tiles.size(); ++t) {
+            std::vector<T> & tile = _tiles[t];
+            for (size_t k = 0; k < tile.size(); ++k) {
+                tile[k] *= rhs;
+            }
+        }
+        _background *= rhs;
+    }
+
+    // Padding of partial tiles is left out
+    T dot(const SparseArray2 & rhs) const
+    {
+        assert(rhs._tiles.size() == _tiles.size());
+        T sum = 0;
+        forEachTile([&](size_t i0, size_t i1, size_t j0, size_t j1) {
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    sum += get(i,j) * rhs.get(i,j);
+                }
+            }
+        });
+        rhs.forEachTile([&](size_t i0, size_t i1, size_t j0, size_t j1) {
+            if (!isActive(i0,j0)) {
+                for (size_t i = i0; i < i1; ++i) {
+                    for (size_t j = j0; j < j1; ++j) {
+                        sum += _background * rhs.get(i,j);
+                    }
+                }
+            }
+        });
+        const size_t numBackground = _nx * _ny - _activeCells(rhs);
+        return sum + numBackground * _background * rhs._background;
+    }
+
+    /**
+        Return the magnitude of the largest or smallest value
+    */
+    T infNorm() const
+    {
+        T norm = _nx * _ny > _activeCells(*this) ? std::fabs(_background) : 0;
+        forEachTile([&](size_t i0, size_t i1, size_t j0, size_t j1) {
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    norm = std::max<T>(norm, std::fabs(get(i,j)));
+                }
+            }
+        });
+        return norm;
+    }
+
+    size_t nx() const { return _nx; }
+    size_t ny() const { return _ny; }
+    float dx() const { return _dx; }
+    T background() const { return _background; }
+
+    size_t numTiles() const { return _tiles.size(); }
+
+    size_t numActiveTiles() const
+    {
+        size_t n = 0;
+        for (size_t t = 0; t < _tiles.size(); ++t) {
+            n += !_tiles[t].empty();
+        }
+        return n;
+    }
+
+    // Bytes used by the values and the tile index
+    size_t memory() const
+    {
+        return numActiveTiles() * T_TILE * T_TILE * sizeof(T) +
+                _tiles.size() * sizeof(std::vector<T>);
+    }
+
+  protected:
+    size_t _nx, _ny;
+    float _dx;
+    size_t _ntx, _nty;
+    T _background;
+    // Tile (ti,tj) is at tj + nty * ti, an empty tile isn't allocated
+    std::vector<std::vector<T> > _tiles;
+
+    size_t _tile(size_t i, size_t j) const
+    {
+        return j / T_TILE + _nty * (i / T_TILE);
+    }
+
+    size_t _local(size_t i, size_t j) const
+    {
+        return j % T_TILE + T_TILE * (i % T_TILE);
+    }
+
+    void _allocate(std::vector<T> & tile)
+    {
+        tile.assign(T_TILE * T_TILE, _background);
+    }
+
+    // Cells in tiles allocated in either this or rhs
+    size_t _activeCells(const SparseArray2 & rhs) const
+    {
+        size_t n = 0;
+        for (size_t ti = 0; ti < _ntx; ++ti) {
+            for (size_t tj = 0; tj < _nty; ++tj) {
+                const size_t t = tj + _nty * ti;
+                if (!_tiles[t].empty() || !rhs._tiles[t].empty()) {
+                    n += (std::min(_nx, (ti + 1) * T_TILE) - ti * T_TILE) *
+                            (std::min(_ny, (tj + 1) * T_TILE) - tj * T_TILE);
+                }
+            }
+        }
+        return n;
+    }
+};
+
+/**
+    FaceArray2 on sparse storage, with the same face access, positions and
+    interpolation.
+*/
+template <typename T, size_t T_DIMX, size_t T_DIMY, int T_TILE = 8>
+class SparseFaceArray2 : public SparseArray2<T, T_TILE>
+{
+  public:
+    SparseFaceArray2() {}
+    SparseFaceArray2(size_t nx, size_t ny, float dx, T background = 0) :
+            SparseArray2<T, T_TILE>(nx + T_DIMX, ny + T_DIMY, dx, background)
+    {
+        assert(T_DIMX || T_DIMY);
+    }
+
+    Vec2f pos(size_t i, size_t j) const
+    {
+        return _dx * Vec2<T>(i + 0.5*T_DIMY, j + 0.5*T_DIMX);
+    }
+
+    template<Faces T_FACE>
+    Vec2<float> pos(size_t i, size_t j) const
+    {
+        if (T_FACE == RIGHT) {
+            return _dx * Vec2<T>(i + 1 + 0.5 * T_DIMY, j + 0.5 * T_DIMX);
+        } else if (T_FACE == TOP) {
+            return _dx * Vec2<T>(i + 0.5 * T_DIMY, j + 1 + 0.5 * T_DIMX);
+        }
+        return _dx * Vec2<T>(i + 0.5 * T_DIMY, j + 0.5 * T_DIMX);
+    }
+
+    template<Faces T_FACE>
+    T & face(size_t i, size_t j)
+    {
+        if (T_FACE == RIGHT || T_FACE == TOP) {
+            return (*this)(i + T_DIMX, j + T_DIMY);
+        }
+        return (*this)(i,j);
+    }
+
+    template<Faces T_FACE>
+    T face(size_t i, size_t j) const
+    {
+        if (T_FACE == RIGHT || T_FACE == TOP) {
+            return (*this)(i + T_DIMX, j + T_DIMY);
+        }
+        return (*this)(i,j);
+    }
+
+    T center(size_t i, size_t j) const
+    {
+        return 0.5*((*this)(i,j) + (*this)(i+T_DIMX,j+T_DIMY));
+    }
+
+    void bary(float x,
+              float y,
+              size_t & i,
+              size_t & j,
+              float & tx,
+              float & ty) const
+    {
+        // Scale from world coordinates to index coordinates
+        x/= _dx;
+        y/= _dx;
+
+        if (x < 0.5 * T_DIMY) {
+            i = 0;
+            tx = 0;
+        } else if (x >= _nx - T_DIMX - 0.5 * T_DIMY) {
+            i = _nx - 2;
+            tx = 1;
+        } else {
+            i = floorf(x - 0.5 * T_DIMY);
+            tx = x - 0.5 * T_DIMY - i;
+        }
+
+        if (y < 0.5 * T_DIMX) {
+            j = 0;
+            ty = 0;
+        } else if (y >= _ny - T_DIMY - 0.5 * T_DIMX) {
+            j = _ny - 2;
+            ty = 1;
+        } else {
+            j = floorf(y - 0.5 * T_DIMX);
+            ty = y - 0.5 * T_DIMX - j;
+        }
+    }
+
+    T bilerp(Vec2f pos) const
+    {
+        return bilerp(pos.x, pos.y);
+    }
+
+    T bilerp(float x, float y) const
+    {
+        size_t i,j;
+        float tx,ty;
+        bary(x, y, i, j, tx, ty);
+        return SparseArray2<T, T_TILE>::bilerp(i, j, tx, ty);
+    }
+
+    void resize(size_t nx, size_t ny, float dx = 1.0)
+    {
+        SparseArray2<T, T_TILE>::resize(nx + T_DIMX, ny + T_DIMY, dx);
+    }
+
+    size_t nx() const { return _nx - 1 * T_DIMX; }
+    size_t ny() const { return _ny - 1 * T_DIMY; }
+
+  protected:
+    using SparseArray2<T, T_TILE>::_nx;
+    using SparseArray2<T, T_TILE>::_ny;
+    using SparseArray2<T, T_TILE>::_dx;
+};
+
+typedef SparseArray2<float> SparseArray2f;
+typedef SparseArray2<double> SparseArray2d;
+typedef SparseFaceArray2<float,1,0> SparseFaceArray2Xf;
+typedef SparseFaceArray2<float,0,1> SparseFaceArray2Yf;
+
+#endif
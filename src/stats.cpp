@@ -0,0 +1,73 @@
+#include "stats.h"
+
+void StepStats::reset()
+{
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        stageTime[s] = 0;
+    }
+    totalTime = 0;
+    numSubsteps = 0;
+    solverIterations = 0;
+    solverResidual = 0;
+    numParticles = 0;
+    numFluidCells = 0;
+}
+
+const char * StepStats::stageName(Stage s)
+{
+    switch (s) {
+        case SORT_PARTICLES:         return "sortParticles";
+        case SAMPLE_VELOCITIES:      return "sampleVelocities";
+        case RECONSTRUCT_SURFACE:    return "reconstructSurface";
+        case REINITIALIZE:           return "reinitialize";
+        case EXTRAPOLATE_INTO_SOLID: return "extrapolateIntoSolid";
+        case APPLY_GRAVITY:          return "applyGravity";
+        case EXTRAPOLATE_VELOCITIES: return "extrapolateVelocities";
+        case BUILD_PRESSURE:         return "buildPressure";
+        case SOLVE_PRESSURE:         return "solvePressure";
+        case PRESSURE_PROJECTION:    return "pressureProjection";
+        case EXTRAPOLATE_PROJECTED:  return "extrapolateProjected";
+        case ENFORCE_BOUNDARY:       return "enforceBoundary";
+        case ADVECT:                 return "advect";
+        case UPDATE_VELOCITIES:      return "updateVelocities";
+        default:                     return "unknown";
+    }
+}
+
+void StepStats::writeCSVHeader(std::ostream & out)
+{
+    out << "frame,substeps,particles,fluidCells,solverIterations,"
+        << "solverResidual,total";
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        out << "," << stageName(static_cast<Stage>(s));
+    }
+    out << "\n";
+}
+
+void StepStats::writeCSV(std::ostream & out, int frame) const
+{
+    out << frame << "," << numSubsteps << "," << numParticles << ","
+        << numFluidCells << "," << solverIterations << ","
+        << solverResidual << "," << totalTime;
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        out << "," << stageTime[s];
+    }
+    out << "\n";
+}
+
+void StepStats::writeJSON(std::ostream & out, int frame) const
+{
+    out << "{\"frame\": " << frame
+        << ", \"substeps\": " << numSubsteps
+        << ", \"particles\": " << numParticles
+        << ", \"fluidCells\": " << numFluidCells
+        << ", \"solverIterations\": " << solverIterations
+        << ", \"solverResidual\": " << solverResidual
+        << ", \"total\": " << totalTime
+        << ", \"stages\": {";
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        out << (s ? ", " : "") << "\"" << stageName(static_cast<Stage>(s))
+            << "\": " << stageTime[s];
+    }
+    out << "}}\n";
+}
@@ -0,0 +1,60 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "timer.h"
+#include <ostream>
+
+/**
+    Timings and counters of one FLIP2D::step. The stage times are summed
+    over all substeps, in seconds.
+*/
+struct StepStats
+{
+    enum Stage
+    {
+        SORT_PARTICLES,
+        SAMPLE_VELOCITIES,
+        RECONSTRUCT_SURFACE,
+        REINITIALIZE,
+        EXTRAPOLATE_INTO_SOLID,
+        APPLY_GRAVITY,
+        EXTRAPOLATE_VELOCITIES,
+        BUILD_PRESSURE,
+        SOLVE_PRESSURE,
+        PRESSURE_PROJECTION,
+        EXTRAPOLATE_PROJECTED,
+        ENFORCE_BOUNDARY,
+        ADVECT,
+        UPDATE_VELOCITIES,
+        NUM_STAGES
+    };
+
+    double stageTime[NUM_STAGES];
+    double totalTime;
+    int numSubsteps;
+    int solverIterations;   // Summed over the substeps
+    float solverResidual;   // Of the last substep
+    int numParticles;
+    int numFluidCells;
+
+    StepStats() { reset(); }
+
+    void reset();
+
+    // Adds the elapsed time to the stage and restarts the timer
+    void record(Stage s, Timer & timer)
+    {
+        stageTime[s] += timer.elapsed();
+        timer.reset();
+    }
+
+    static const char * stageName(Stage s);
+
+    static void writeCSVHeader(std::ostream & out);
+
+    void writeCSV(std::ostream & out, int frame) const;
+
+    void writeJSON(std::ostream & out, int frame) const;
+};
+
+#endif
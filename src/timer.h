@@ -0,0 +1,30 @@
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <chrono>
+
+/**
+    Wall clock timer with sub-microsecond resolution.
+*/
+class Timer
+{
+  public:
+    Timer() { reset(); }
+
+    void reset() { _start = std::chrono::steady_clock::now(); }
+
+    /**
+        Returns the number of seconds since construction or the last reset.
+    */
+    double elapsed() const
+    {
+        const std::chrono::duration<double> d =
+                std::chrono::steady_clock::now() - _start;
+        return d.count();
+    }
+
+  protected:
+    std::chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define VEC2_H_
 
 #include <iostream>
+#include <cmath>
 
 template<typename T>
 class Vec2
@@ -0,0 +1,52 @@
+#ifndef WAVEFRONT_H_
+#define WAVEFRONT_H_
+
+#include <algorithm>
+
+// Default tile size, small enough for plenty of tiles per diagonal and large
+// enough to amortize the scheduling
+const int WAVEFRONT_TILE = 32;
+
+/**
+    Level scheduled traversal for loops where cell (i,j) depends on the
+    already updated cells (i-di,j) and (i,j-dj), like Gauss-Seidel style
+    sweeps and triangular solves. The cells in [i0,i1) x [j0,j1) are split
+    into tiles of tileSize x tileSize. A tile only depends on its upwind
+    neighbour tiles, so the tiles on one anti-diagonal run in parallel and
+    the diagonals are processed in sweep order.
+
+    The functor is called as f(ti0, ti1, tj0, tj1) with the half open cell
+    range of a tile, and must loop over the tile in the sweep direction.
+    The result is identical to one serial loop over the whole range.
+*/
+template<typename T_FUNCTOR>
+void wavefront(int i0,
+               int i1,
+               int j0,
+               int j1,
+               int tileSize,
+               bool reverseI,
+               bool reverseJ,
+               const T_FUNCTOR & f)
+{
+    if (i1 <= i0 || j1 <= j0) {
+        return;
+    }
+    const int numTilesI = (i1 - i0 + tileSize - 1) / tileSize;
+    const int numTilesJ = (j1 - j0 + tileSize - 1) / tileSize;
+    for (int d = 0; d < numTilesI + numTilesJ - 1; ++d) {
+        const int tBegin = std::max(0, d - numTilesJ + 1);
+        const int tEnd = std::min(d + 1, numTilesI);
+#pragma omp parallel for schedule(dynamic)
+        for (int t = tBegin; t < tEnd; ++t) {
+            const int ti = reverseI ? numTilesI - 1 - t : t;
+            const int tj = reverseJ ? numTilesJ - 1 - (d - t) : d - t;
+            f(i0 + ti * tileSize,
+              std::min(i1, i0 + (ti + 1) * tileSize),
+              j0 + tj * tileSize,
+              std::min(j1, j0 + (tj + 1) * tileSize));
+        }
+    }
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 
 void filename(std::string & input, int frame)
 {
@@ -37,14 +39,22 @@ int main(int argc, char *argv[]) {
     s->initialFluidCenter = Vec2f(0.5,0.25);
     s->initialFluidRadius = 0.33;
     s->particlesPerCell = 4;
+    s->particleSortInterval = 10;
     s->R = 1.0 * s->dx;
     s->r = 0.6 * s->dx;
     s->numPhiSweepIterations = 2;
+    s->useParallelReconstruction = true;
     s->gravity = Vec2f(0.0f, -0.82f);
     s->numVelSweepIterations = 4;
+    s->useParallelSampling = true;
+    s->warmStart = true;
     s->usePCG = true;
     s->tolerance = 1e-5;
     s->maxIterations = 100;
+    s->outputQueueDepth = 2;
+    s->compressOutput = true;
+    s->outputPositionError = 0.01 * s->dx;
+    s->outputVelocityError = 1e-3;
 
     FLIP2D::Ptr flip = FLIP2D::create(s);
     flip->write("test.flip2D");
@@ -52,14 +62,26 @@ int main(int argc, char *argv[]) {
     if (argc > 1) {
         simOutput = argv[1];
     } else {
-        simOutput = "sim/boxSim.$F.flip2D";
+        simOutput = "sim/boxSim.flip2Ds";
     }
+    // Without $F every frame is appended to one sequence file
+    const bool sequence = simOutput.find("$F") == std::string::npos;
+    if (sequence) {
+        std::remove(simOutput.c_str());
+    }
+    std::ofstream stats(argc > 2 ? argv[2] : "boxStats.csv");
+    StepStats::writeCSVHeader(stats);
     int nFrames = 24;
     for(int i = 0; i < nFrames; ++i) {
         LOG_OUTPUT_WITHOUT_TIMESTAMPS(frame(i));
-        flip->step(1.0/24.0);
-        std::string simOutputFrame = simOutput;
-        filename(simOutputFrame,i);
-        flip->write(simOutputFrame.c_str());
+        flip->step(1.0/24.0).writeCSV(stats, i);
+        if (sequence) {
+            flip->append(simOutput.c_str(), i);
+        } else {
+            std::string simOutputFrame = simOutput;
+            filename(simOutputFrame,i);
+            flip->write(simOutputFrame.c_str());
+        }
     }
+    flip->flush();
 }
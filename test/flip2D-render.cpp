@@ -0,0 +1,152 @@
+#include "../src/flip2D.h"
+#include "../src/sequence.h"
+#include "../src/render.h"
+#include "../src/log.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+/**
+    Headless renderer, for nodes without OpenGL or a display.
+
+    flip2D-render input output [options]
+
+    input is either a frame file pattern with $F or a sequence file, output
+    a pattern with $F ending in .png or .ppm. Frames are rendered in
+    parallel, one frame per thread.
+
+    -phi              Render the reconstructed fluid surface, not particles
+    -width <pixels>   Image width, default 512. The height keeps the aspect.
+    -radius <pixels>  Particle splat radius, default 1.5
+    -first <frame>    First frame, default 0
+    -last <frame>     Last frame, default the last one found
+*/
+
+void filename(std::string & input, int frame)
+{
+    size_t pos = input.find("$F");
+    if (pos != std::string::npos) {
+        std::stringstream ss;
+        ss << frame;
+        input.replace(pos,2, ss.str());
+    }
+}
+
+bool exists(const std::string & file)
+{
+    std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    return in.is_open();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "usage: flip2D-render input output [-phi] "
+                  << "[-width pixels] [-radius pixels] "
+                  << "[-first frame] [-last frame]" << std::endl;
+        return 1;
+    }
+    const std::string input = argv[1];
+    const std::string output = argv[2];
+    bool phi = false;
+    int width = 512;
+    float radius = 1.5f;
+    int first = 0;
+    int last = -1;
+    for (int i = 3; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "-phi") {
+            phi = true;
+        } else if (option == "-width" && i + 1 < argc) {
+            width = atoi(argv[++i]);
+        } else if (option == "-radius" && i + 1 < argc) {
+            radius = atof(argv[++i]);
+        } else if (option == "-first" && i + 1 < argc) {
+            first = atoi(argv[++i]);
+        } else if (option == "-last" && i + 1 < argc) {
+            last = atoi(argv[++i]);
+        } else {
+            std::cerr << "flip2D-render error: unknown option " << option
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // Frame numbers to render, and their index if input is a sequence
+    const bool sequence = input.find("$F") == std::string::npos;
+    std::vector<int> frames;
+    std::vector<int> indices;
+    if (sequence) {
+        SequenceReader::Ptr reader = SequenceReader::open(input.c_str());
+        if (!reader) {
+            return 1;
+        }
+        for (int i = 0; i < reader->numFrames(); ++i) {
+            const int frame = reader->entry(i).frame;
+            if (frame >= first && (last < 0 || frame <= last) &&
+                reader->find(frame) == i) {
+                frames.push_back(frame);
+                indices.push_back(i);
+            }
+        }
+    } else {
+        for (int frame = first; last < 0 || frame <= last; ++frame) {
+            std::string file = input;
+            filename(file, frame);
+            if (!exists(file)) {
+                break;
+            }
+            frames.push_back(frame);
+            indices.push_back(-1);
+        }
+    }
+    LOG_OUTPUT("Rendering " << frames.size() << " frames from " << input);
+
+    const Color fluid(0.25f, 0.55f, 0.95f);
+    const Color background(0.05f, 0.05f, 0.08f);
+    const int n = frames.size();
+    int numFailed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:numFailed)
+    for (int k = 0; k < n; ++k) {
+        Settings::Ptr s = Settings::create();
+        Particles::Ptr p = Particles::create();
+        bool ok;
+        if (sequence) {
+            ok = FLIP2D::read(input.c_str(), indices[k], s, p);
+        } else {
+            std::string file = input;
+            filename(file, frames[k]);
+            ok = FLIP2D::read(file.c_str(), s, p);
+        }
+        if (!ok) {
+            ++numFailed;
+            continue;
+        }
+
+        const Vec2f extent(s->nx * s->dx, s->ny * s->dx);
+        Image image(width, std::max(1, static_cast<int>(
+                width * extent.y / extent.x + 0.5f)));
+        if (phi) {
+            // The frame doesn't store r, use the ratio of the box test
+            s->r = 0.6f * s->R;
+            s->useParallelReconstruction = false;
+            FluidSDF::Ptr sdf = FluidSDF::create(s);
+            sdf->reconstructSurface(p, s->R, s->r);
+            sdf->reinitialize(s->numPhiSweepIterations);
+            renderPhi(sdf->phi(), extent, fluid, background, image);
+        } else {
+            renderParticles(*p.ptr(), extent, radius, fluid, background,
+                            image);
+        }
+
+        std::string file = output;
+        filename(file, frames[k]);
+        numFailed += !image.write(file);
+    }
+    Log::instance().flush();
+    return numFailed > 0;
+}
@@ -3,15 +3,19 @@
 #include <GL/glut.h>
 
 #include "../src/flip2D.h"
+#include "../src/frameReader.h"
 
 #include <iostream>
 #include <string>
 #include <sstream>
 
 Settings::Ptr settings;
+FrameCache::Ptr frames = FrameCache::create(16);
 
 int frame = 0;
 std::string simfile;
+// Without $F the frames are read from one sequence file
+bool sequence = false;
 
 void filename(std::string & input, int frame)
 {
@@ -31,15 +35,19 @@ void display()
     //Read frame
     std::string simfileFrame = simfile;
     filename(simfileFrame,frame);
-    Particles::Ptr particles = Particles::create();
-    FLIP2D::read(simfileFrame.c_str(), settings, particles);
+    MappedFrame::Ptr particles = frames->frame(simfileFrame,
+                                               sequence ? frame : -1);
     
-    glColor3f(1.0, 1.0, 1.0);
-    glBegin(GL_POINTS);
-    for (int i = 0; i < particles->numParticles(); ++i) {
-        glVertex2f(particles->pos(i).x, particles->pos(i).y);
+    if (particles) {
+        const FloatView & x = particles->posX();
+        const FloatView & y = particles->posY();
+        glColor3f(1.0, 1.0, 1.0);
+        glBegin(GL_POINTS);
+        for (int i = 0; i < particles->numParticles(); ++i) {
+            glVertex2f(x[i], y[i]);
+        }
+        glEnd();
     }
-    glEnd();
     
     glutSwapBuffers();
 }
@@ -50,6 +58,11 @@ void keyboard(unsigned char key, int x, int y)
         case 's':
             ++frame;
             break;
+        case 'a':
+            if (frame > 0) {
+                --frame;
+            }
+            break;
     }
 }
 
@@ -73,11 +86,16 @@ int main(int argc, char **argv)
         exit(0);
     } else {
         simfile = std::string(argv[1]);
+        sequence = simfile.find("$F") == std::string::npos;
         std::string simfileFirst = simfile;
         filename(simfileFirst,0);
         settings = Settings::create();
         Particles::Ptr particles = Particles::create();
-        FLIP2D::read(simfileFirst.c_str(), settings, particles);
+        if (sequence) {
+            FLIP2D::read(simfile.c_str(), 0, settings, particles);
+        } else {
+            FLIP2D::read(simfileFirst.c_str(), settings, particles);
+        }
     }
     
     glutInit(&argc, argv);
@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "../src/array.h"
+#include "../src/sparseArray.h"
 
 
 bool printPassed = false;
@@ -140,6 +141,116 @@ int main(int argc, char *argv[]) {
     numFailed += test(c.bilerp(2.0,1.5) == (9+6)/2.0, "bilerp face");
     numFailed += test(c.bilerp(1.5,1.5) == (5+6+8+9)/4.0, "bilerp face");
     numFailed += test(c.center(1,1) == (5+6+8+9)/4.0, "center");
+
+    // The Morton tile layout is a permutation of the linear one, and
+    // forEach walks it in storage order
+    TiledArray2f tiled(37,21,0.1);
+    Array2f linear(37,21,0.1);
+    std::vector<int> visits(37 * 21, 0);
+    size_t expected = 0;
+    bool ordered = true;
+    tiled.forEach([&](size_t i, size_t j) {
+        ordered = ordered && tiled.layout().index(i,j) == expected++;
+        ++visits[j + 21 * i];
+    });
+    numFailed += test(ordered && expected == visits.size(), "tiled order");
+    numFailed += test(std::count(visits.begin(), visits.end(), 1) ==
+                      static_cast<int>(visits.size()), "tiled visits");
+    numFailed += test(tiled.layout().index(8,0) == 64, "tiled morton");
+    numFailed += test(tiled.layout().index(0,8) == 128, "tiled morton");
+    for (int i = 0; i < 37; ++i) {
+        for (int j = 0; j < 21; ++j) {
+            tiled(i,j) = linear(i,j) = 0.25f * i - 0.5f * j * j;
+        }
+    }
+    numFailed += test(tiled.bilerp(1.234,0.987) == linear.bilerp(1.234,0.987),
+                      "tiled bilerp");
+    // Same sum in another order
+    numFailed += test(std::fabs(tiled.dot(tiled) / linear.dot(linear) - 1) <
+                      1e-5, "tiled dot");
+    numFailed += test(tiled.infNorm() == linear.infNorm(), "tiled infNorm");
+
+    TiledFaceArray2Xf tiledU(20,10,0.5);
+    FaceArray2Xf linearU(20,10,0.5);
+    for (int i = 0; i < 20; ++i) {
+        for (int j = 0; j < 10; ++j) {
+            tiledU.face<RIGHT>(i,j) = linearU.face<RIGHT>(i,j) = i * j;
+        }
+    }
+    numFailed += test(tiledU.bilerp(3.3,2.1) == linearU.bilerp(3.3,2.1),
+                      "tiled face bilerp");
+
+    // Sparse arrays match the dense ones, and only allocate written tiles
+    SparseArray2f sparse(100,60,0.1);
+    Array2f dense(100,60,0.1);
+    numFailed += test(sparse.numTiles() == 13 * 8, "sparse tiles");
+    numFailed += test(sparse.numActiveTiles() == 0, "sparse empty");
+    for (int i = 40; i < 52; ++i) {
+        for (int j = 20; j < 30; ++j) {
+            sparse(i,j) = dense(i,j) = 0.5f * i - j;
+        }
+    }
+    numFailed += test(sparse.numActiveTiles() == 4, "sparse allocation");
+    numFailed += test(sparse.get(0,0) == 0 && sparse.numActiveTiles() == 4,
+                      "sparse get");
+    bool same = true;
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 60; ++j) {
+            same = same && sparse.get(i,j) == dense(i,j);
+        }
+    }
+    numFailed += test(same, "sparse values");
+    numFailed += test(sparse.bilerp(4.53,2.27) == dense.bilerp(4.53,2.27),
+                      "sparse bilerp");
+    numFailed += test(sparse.bilerp(9.99,5.99) == dense.bilerp(9.99,5.99),
+                      "sparse bilerp");
+    numFailed += test(sparse.dot(sparse) == dense.dot(dense), "sparse dot");
+    numFailed += test(sparse.infNorm() == dense.infNorm(), "sparse infNorm");
+
+    SparseArray2f shifted(100,60,0.1);
+    shifted.set(1.0f);
+    shifted(0,0) = 2.0f;
+    shifted.add(sparse, 2.0f);
+    dense.add(dense);
+    dense.add(1.0f);
+    dense(0,0) += 1.0f;
+    same = true;
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 60; ++j) {
+            same = same && shifted.get(i,j) == dense(i,j);
+        }
+    }
+    numFailed += test(same && shifted.numActiveTiles() == 5, "sparse add");
+    numFailed += test(shifted.dot(sparse) == sparse.dot(shifted),
+                      "sparse dot background");
+
+    SparseArray2f copied(100,60,0.1);
+    copied.copy(dense);
+    numFailed += test(copied.numActiveTiles() == 104, "sparse copy");
+    copied.set(1.0f);
+    copied.copy(dense);
+    numFailed += test(copied.numActiveTiles() == 5, "sparse copy background");
+    sparse.multiply(0.0f);
+    sparse.prune();
+    numFailed += test(sparse.numActiveTiles() == 0, "sparse prune");
+
+    FaceArray2Xf denseU(20,10,0.5);
+    SparseFaceArray2Xf sparseU(20,10,0.5);
+    for (int i = 0; i < 10; ++i) {
+        for (int j = 2; j < 7; ++j) {
+            denseU.face<RIGHT>(i,j) = sparseU.face<RIGHT>(i,j) = i + 0.1f * j;
+        }
+    }
+    numFailed += test(sparseU.nx() == 20 && sparseU.ny() == 10,
+                      "sparse face dims");
+    numFailed += test(sparseU.face<LEFT>(3,4) == denseU.face<LEFT>(3,4),
+                      "sparse face");
+    numFailed += test(sparseU.pos<RIGHT>(3,4).x == denseU.pos<RIGHT>(3,4).x,
+                      "sparse face pos");
+    numFailed += test(sparseU.bilerp(2.3,1.7) == denseU.bilerp(2.3,1.7),
+                      "sparse face bilerp");
+    numFailed += test(sparseU.bilerp(9.9,4.9) == denseU.bilerp(9.9,4.9),
+                      "sparse face bilerp");
     
     std::cout << "Number of failed tests: " << numFailed << std::endl;    
 }
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "../src/flip2D.h"
+
+bool printPassed = false;
+
+int test(bool cond, const char * msg)
+{
+    if (cond) {
+        if (printPassed) {
+            std::cout << msg << " ... PASSED" << std::endl;
+        }
+        return 0;
+    } else {
+        std::cout << msg << " ... FAILED" << std::endl;
+        return 1;
+    }
+}
+
+Settings::Ptr settings(bool multigrid)
+{
+    Settings::Ptr s = Settings::create();
+    s->nx = 32;
+    s->ny = 32;
+    s->dx = 1.0 / 33.0;
+    s->solidWidth = 2.0f;
+    s->initialFluidCenter = Vec2f(0.5, 0.3);
+    s->initialFluidRadius = 0.25;
+    s->particlesPerCell = 4;
+    s->particleSortInterval = 3;
+    s->R = 1.0 * s->dx;
+    s->r = 0.6 * s->dx;
+    s->numPhiSweepIterations = 2;
+    s->gravity = Vec2f(0.0f, -0.82f);
+    s->numVelSweepIterations = 4;
+    s->warmStart = true;
+    s->seed = 7;
+    s->usePCG = !multigrid;
+    s->useMultigrid = multigrid;
+    s->nxMin = 4;
+    s->tolerance = 1e-5;
+    s->maxIterations = 100;
+    return s;
+}
+
+std::string contents(const char * filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Runs a few steps, checkpoints, and compares the continued simulation with
+// one restored from the checkpoint. Both end states must be identical.
+bool resumesExactly(bool multigrid)
+{
+    FLIP2D::Ptr flip = FLIP2D::create(settings(multigrid));
+    for (int i = 0; i < 3; ++i) {
+        flip->step(1.0 / 24.0);
+    }
+    if (!flip->checkpoint("testCheckpoint.flip2Dc")) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        flip->step(1.0 / 24.0);
+    }
+    flip->checkpoint("testCheckpointA.flip2Dc");
+
+    FLIP2D::Ptr restored = FLIP2D::restore("testCheckpoint.flip2Dc");
+    if (!restored) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        restored->step(1.0 / 24.0);
+    }
+    restored->checkpoint("testCheckpointB.flip2Dc");
+
+    const std::string a = contents("testCheckpointA.flip2Dc");
+    return !a.empty() && a == contents("testCheckpointB.flip2Dc");
+}
+
+bool rejectsCorrupt()
+{
+    const std::string c = contents("testCheckpoint.flip2Dc");
+    std::ofstream out("testCheckpointC.flip2Dc",
+                      std::ios::out | std::ios::binary);
+    out.write(c.data(), c.size() / 2);
+    out.close();
+    std::ofstream notCheckpoint("testCheckpointD.flip2Dc",
+                                std::ios::out | std::ios::binary);
+    notCheckpoint << "F2DZ";
+    notCheckpoint.close();
+    return !FLIP2D::restore("testCheckpointC.flip2Dc") &&
+            !FLIP2D::restore("testCheckpointD.flip2Dc") &&
+            !FLIP2D::restore("testCheckpointMissing.flip2Dc");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        printPassed = true;
+    }
+    int failed = 0;
+    failed += test(resumesExactly(false), "Restored PCG simulation resumes exactly");
+    failed += test(resumesExactly(true), "Restored multigrid simulation resumes exactly");
+    failed += test(rejectsCorrupt(), "Corrupt checkpoints are rejected");
+    std::cout << "Number of failed tests: " << failed << std::endl;
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+
+#include "../src/frame.h"
+#include "../src/compress.h"
+#include "../src/frameReader.h"
+#include "../src/sequence.h"
+#include <fstream>
+#include "../src/util.h"
+
+bool printPassed = false;
+
+int test(bool cond, const char * msg)
+{
+    if (cond) {
+        if (printPassed) {
+            std::cout << msg << " ... PASSED" << std::endl;
+        }
+        return 0;
+    } else {
+        std::cout << msg << " ... FAILED" << std::endl;
+        return 1;
+    }
+}
+
+float maxError(const Particles & a, const Particles & b, bool velocity)
+{
+    float e = 0;
+    for (int i = 0; i < a.numParticles(); ++i) {
+        const Vec2f d = velocity ? a.vel(i) - b.vel(i) : a.pos(i) - b.pos(i);
+        e = max(e, max(std::fabs(d.x), std::fabs(d.y)));
+    }
+    return e;
+}
+
+bool roundTrip(Settings::Ptr s, Particles::Ptr p, Particles::Ptr q,
+               size_t & size)
+{
+    std::ostringstream settings;
+    s->write(settings);
+    std::stringstream file;
+    writeFrame(file, settings.str(), *p.ptr(), FrameFormat(*s.ptr()));
+    size = file.str().size();
+    Settings::Ptr t = Settings::create();
+    return readFrame(file, *t.ptr(), *q.ptr()) && t->nx == s->nx;
+}
+
+bool matchesMapped(Settings::Ptr s, Particles::Ptr p, FrameCache::Ptr cache,
+                   const char * filename)
+{
+    std::ostringstream settings;
+    s->write(settings);
+    std::ofstream file(filename, std::ios::out | std::ios::binary);
+    writeFrame(file, settings.str(), *p.ptr(), FrameFormat(*s.ptr()));
+    file.close();
+
+    MappedFrame::Ptr frame = cache->frame(filename);
+    if (!frame || frame->numParticles() != p->numParticles() ||
+        frame->settings().nx != s->nx) {
+        return false;
+    }
+    for (int i = 0; i < p->numParticles(); ++i) {
+        if (frame->posX()[i] != p->pos(i).x ||
+            frame->posY()[i] != p->pos(i).y ||
+            frame->velX()[i] != p->vel(i).x ||
+            frame->velY()[i] != p->vel(i).y) {
+            return false;
+        }
+    }
+    return cache->frame(filename) == frame;
+}
+
+// Writes frames 0, 1 and 2, reopening the sequence for the last one
+bool writeSequence(Settings::Ptr s, Particles::Ptr p, const char * filename)
+{
+    std::remove(filename);
+    std::ostringstream settings;
+    s->write(settings);
+    SequenceWriter::Ptr writer = SequenceWriter::open(filename);
+    if (!writer ||
+        !writer->append(0, settings.str(), *p.ptr(), FrameFormat()) ||
+        !writer->append(1, settings.str(), *p.ptr(), FrameFormat(*s.ptr()))) {
+        return false;
+    }
+    writer = SequenceWriter::open(filename);
+    return writer && writer->numFrames() == 2 &&
+            writer->append(2, settings.str(), *p.ptr(), FrameFormat());
+}
+
+bool matchesSequence(Particles::Ptr p, const char * filename, int frames)
+{
+    SequenceReader::Ptr reader = SequenceReader::open(filename);
+    if (!reader || reader->numFrames() != frames) {
+        return false;
+    }
+    Settings::Ptr t = Settings::create();
+    Particles::Ptr q = Particles::create();
+    for (int i = 0; i < frames; ++i) {
+        if (reader->find(i) != i || !reader->read(i, *t.ptr(), *q.ptr()) ||
+            reader->entry(i).numParticles != p->numParticles() ||
+            maxError(*p.ptr(), *q.ptr(), false) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::cout << "Starting frame format test..." << std::endl;
+
+    int numFailed = 0;
+
+    // Byte coding, including an empty and a constant buffer
+    std::vector<unsigned char> bytes, decoded;
+    for (int k = 0; k < 10000; ++k) {
+        bytes.push_back(k % 7 == 0 ? k % 251 : 3);
+    }
+    std::stringstream buffer;
+    encodeBytes(buffer, bytes);
+    encodeBytes(buffer, std::vector<unsigned char>());
+    encodeBytes(buffer, std::vector<unsigned char>(100, 42));
+    numFailed += test(decodeBytes(buffer, decoded, bytes.size()) &&
+                      decoded == bytes, "rANS round trip");
+    numFailed += test(buffer.str().size() < bytes.size() / 2,
+                      "rANS compresses");
+    numFailed += test(decodeBytes(buffer, decoded, 0) && decoded.empty(),
+                      "Empty buffer");
+    numFailed += test(decodeBytes(buffer, decoded, 100) &&
+                      decoded == std::vector<unsigned char>(100, 42),
+                      "Constant buffer");
+
+    Settings::Ptr s = Settings::create();
+    s->nx = 64;
+    s->ny = 32;
+    s->dx = 1.0 / 64.0;
+    Particles::Ptr p = Particles::create();
+    for (int k = 0; k < 5000; ++k) {
+        p->addParticle(Vec2f(random(0.0, 1.0), random(0.0, 0.5)),
+                       Vec2f(random(-2.0, 2.0), random(-2.0, 2.0)));
+    }
+    p->sortByCell(s->nx, s->ny, s->dx);
+
+    Particles::Ptr q = Particles::create();
+    size_t legacySize, size;
+    numFailed += test(roundTrip(s, p, q, legacySize) &&
+                      maxError(*p.ptr(), *q.ptr(), false) == 0 &&
+                      maxError(*p.ptr(), *q.ptr(), true) == 0,
+                      "Legacy format");
+
+    s->compressOutput = true;
+    numFailed += test(roundTrip(s, p, q, size) &&
+                      maxError(*p.ptr(), *q.ptr(), false) == 0 &&
+                      maxError(*p.ptr(), *q.ptr(), true) == 0,
+                      "Lossless compressed format");
+
+    s->outputPositionError = 1e-4;
+    s->outputVelocityError = 1e-3;
+    numFailed += test(roundTrip(s, p, q, size) &&
+                      maxError(*p.ptr(), *q.ptr(), false) <= 1e-4 * 1.001 &&
+                      maxError(*p.ptr(), *q.ptr(), true) <= 1e-3 * 1.001,
+                      "Quantized error bounds");
+    numFailed += test(size < legacySize / 2, "Quantized size");
+
+    s->outputVelocityError = -1;
+    numFailed += test(roundTrip(s, p, q, size) &&
+                      maxError(*p.ptr(), *q.ptr(), false) <= 1e-4 * 1.001 &&
+                      q->vel(0).x == 0 && q->vel(0).y == 0,
+                      "Dropped velocities");
+
+    // Mapped reading of both formats, and the cache eviction
+    FrameCache::Ptr cache = FrameCache::create(1);
+    s->compressOutput = false;
+    numFailed += test(matchesMapped(s, p, cache, "testFrame.0.flip2D"),
+                      "Mapped legacy frame");
+    s->compressOutput = true;
+    s->outputPositionError = 0;
+    s->outputVelocityError = 0;
+    numFailed += test(matchesMapped(s, p, cache, "testFrame.1.flip2D"),
+                      "Mapped compressed frame");
+    numFailed += test(cache->size() == 1, "Frame cache capacity");
+    numFailed += test(!cache->frame("testFrame.missing.flip2D"),
+                      "Missing frame");
+
+    // Sequence files, including one cut off in the middle of a record
+    const char * sequence = "testFrame.flip2Ds";
+    numFailed += test(writeSequence(s, p, sequence) &&
+                      matchesSequence(p, sequence, 3), "Sequence");
+    MappedFrame::Ptr mapped = cache->frame(sequence, 2);
+    numFailed += test(mapped && mapped->numParticles() == p->numParticles() &&
+                      mapped->posX()[7] == p->pos(7).x, "Mapped sequence frame");
+    numFailed += test(!cache->frame(sequence, 3), "Missing sequence frame");
+    std::string contents;
+    {
+        std::ifstream in(sequence, std::ios::in | std::ios::binary);
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        contents = ss.str();
+    }
+    {
+        std::ofstream out(sequence, std::ios::out | std::ios::binary);
+        out.write(contents.data(), contents.size() - 1000);
+    }
+    SequenceReader::Ptr damaged = SequenceReader::open(sequence);
+    numFailed += test(damaged && damaged->recovered() &&
+                      matchesSequence(p, sequence, 2), "Recovered sequence");
+    std::ostringstream settings;
+    s->write(settings);
+    SequenceWriter::Ptr writer = SequenceWriter::open(sequence);
+    numFailed += test(writer && writer->append(5, settings.str(), *p.ptr(),
+                                               FrameFormat()) &&
+                      SequenceReader::open(sequence)->find(5) == 2 &&
+                      !SequenceReader::open(sequence)->recovered(),
+                      "Append after recovery");
+
+    std::cout << "Number of failed tests: " << numFailed << std::endl;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <vector>
+
+#include "../src/interpolate.h"
+#include "../src/simd.h"
+#include "../src/util.h"
+
+bool printPassed = false;
+
+int test(bool cond, const char * msg)
+{
+    if (cond) {
+        if (printPassed) {
+            std::cout << msg << " ... PASSED" << std::endl;
+        }
+        return 0;
+    } else {
+        std::cout << msg << " ... FAILED" << std::endl;
+        return 1;
+    }
+}
+
+template<typename T_ARRAY>
+bool matchesBilerp(const T_ARRAY & a,
+                   const std::vector<float> & x,
+                   const std::vector<float> & y)
+{
+    std::vector<float> out(x.size());
+    bilerp(a, &x[0], &y[0], &out[0], x.size());
+    for (size_t k = 0; k < x.size(); ++k) {
+        if (out[k] != a.bilerp(x[k], y[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::cout << "Starting interpolation test..." << std::endl;
+
+    const int nx = 37;
+    const int ny = 23;
+    const float dx = 0.1;
+    FaceArray2Xf u(nx, ny, dx);
+    FaceArray2Yf v(nx, ny, dx);
+    for (int i = 0; i < u.nx() + 1; ++i) {
+        for (int j = 0; j < u.ny(); ++j) {
+            u(i,j) = random(-1.0, 1.0);
+        }
+    }
+    for (int i = 0; i < v.nx(); ++i) {
+        for (int j = 0; j < v.ny() + 1; ++j) {
+            v(i,j) = random(-1.0, 1.0);
+        }
+    }
+
+    // Include positions outside the domain to test the clamping, and a
+    // count that isn't a multiple of the vector width
+    std::vector<float> x, y;
+    for (int k = 0; k < 1003; ++k) {
+        x.push_back(random(-0.5, nx * dx + 0.5));
+        y.push_back(random(-0.5, ny * dx + 0.5));
+    }
+    x.push_back(0.0f);
+    y.push_back(0.0f);
+    x.push_back(nx * dx);
+    y.push_back(ny * dx);
+
+    int numFailed = 0;
+    const char * names[] = { "scalar", "avx2", "avx512" };
+    for (int level = SIMD_SCALAR; level <= SIMD_AVX512; ++level) {
+        setMaxSimdLevel(static_cast<SimdLevel>(level));
+        numFailed += test(matchesBilerp(u, x, y), names[level]);
+        numFailed += test(matchesBilerp(v, x, y), names[level]);
+    }
+    
+    std::cout << "Number of failed tests: " << numFailed << std::endl;
+}
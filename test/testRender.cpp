@@ -0,0 +1,138 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "../src/render.h"
+#include "../src/sequence.h"
+
+bool printPassed = false;
+
+int test(bool cond, const char * msg)
+{
+    if (cond) {
+        if (printPassed) {
+            std::cout << msg << " ... PASSED" << std::endl;
+        }
+        return 0;
+    } else {
+        std::cout << msg << " ... FAILED" << std::endl;
+        return 1;
+    }
+}
+
+std::string contents(const char * filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+uint32_t bigEndian(const std::string & s, size_t offset)
+{
+    const unsigned char * p =
+            reinterpret_cast<const unsigned char *>(s.data() + offset);
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Checks the chunk CRCs and inflates the stored blocks of the image data
+bool matchesPNG(const Image & image, const char * filename)
+{
+    const std::string png = contents(filename);
+    if (png.size() < 8 || png.compare(1, 3, "PNG") != 0) {
+        return false;
+    }
+    std::string idat;
+    for (size_t offset = 8; offset + 12 <= png.size(); ) {
+        const uint32_t length = bigEndian(png, offset);
+        if (checksum(png.data() + offset + 4, length + 4) !=
+            bigEndian(png, offset + 8 + length)) {
+            return false;
+        }
+        if (png.compare(offset + 4, 4, "IHDR") == 0 &&
+            (bigEndian(png, offset + 8) != uint32_t(image.width()) ||
+             bigEndian(png, offset + 12) != uint32_t(image.height()))) {
+            return false;
+        }
+        if (png.compare(offset + 4, 4, "IDAT") == 0) {
+            idat.append(png, offset + 8, length);
+        }
+        offset += 12 + length;
+    }
+
+    std::string raw;
+    size_t offset = 2;
+    bool last = false;
+    while (!last && offset + 5 <= idat.size()) {
+        last = idat[offset] & 1;
+        const size_t n = static_cast<unsigned char>(idat[offset + 1]) |
+                static_cast<unsigned char>(idat[offset + 2]) << 8;
+        raw.append(idat, offset + 5, n);
+        offset += 5 + n;
+    }
+    const size_t row = 3 * image.width();
+    if (!last || raw.size() != (row + 1) * image.height()) {
+        return false;
+    }
+    for (int y = 0; y < image.height(); ++y) {
+        if (raw[(row + 1) * y] != 0 ||
+            raw.compare((row + 1) * y + 1, row,
+                        reinterpret_cast<const char *>(image.pixel(0, y)),
+                        row) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::cout << "Starting render test..." << std::endl;
+    if (argc > 1) {
+        printPassed = true;
+    }
+
+    int numFailed = 0;
+
+    // A particle in the lower left quarter of a 2 x 1 domain
+    Particles::Ptr p = Particles::create();
+    p->addParticle(Vec2f(0.5, 0.25), Vec2f(0, 0));
+    const Color fluid(1, 1, 1);
+    const Color background(0, 0, 0);
+    Image image(200, 100);
+    renderParticles(*p.ptr(), Vec2f(2, 1), 3.0f, fluid, background, image);
+    numFailed += test(image.pixel(50, 75)[0] > 128 &&
+                      image.pixel(50, 25)[0] == 0 &&
+                      image.pixel(150, 75)[0] == 0, "Particle splat");
+
+    // Circle of radius 0.25 around (0.5, 0.5)
+    Array2f phi(32, 32, 1.0 / 32.0);
+    for (int i = 0; i < 32; ++i) {
+        for (int j = 0; j < 32; ++j) {
+            phi(i,j) = (phi.pos(i,j) - Vec2f(0.5, 0.5)).length() - 0.25;
+        }
+    }
+    Image circle(64, 64);
+    renderPhi(phi, Vec2f(1, 1), fluid, background, circle);
+    numFailed += test(circle.pixel(32, 32)[0] == 255 &&
+                      circle.pixel(2, 2)[0] == 0 &&
+                      circle.pixel(16, 32)[0] > 0 &&
+                      circle.pixel(16, 32)[0] < 255, "Level set");
+
+    numFailed += test(circle.write("testRender.png") &&
+                      matchesPNG(circle, "testRender.png"), "PNG");
+
+    // More than one stored block
+    Image large(300, 300);
+    renderPhi(phi, Vec2f(1, 1), fluid, background, large);
+    numFailed += test(large.write("testRender.large.png") &&
+                      matchesPNG(large, "testRender.large.png"),
+                      "PNG with several blocks");
+
+    const std::string ppm = circle.write("testRender.ppm") ?
+            contents("testRender.ppm") : std::string();
+    numFailed += test(ppm.compare(0, 13, "P6\n64 64\n255\n") == 0 &&
+                      ppm.size() == 13 + 3 * 64 * 64, "PPM");
+
+    std::cout << "Number of failed tests: " << numFailed << std::endl;
+}
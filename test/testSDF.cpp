@@ -1,8 +1,11 @@
 #include <iostream>
+#include <cmath>
 
 #include "../src/sdf.h"
+#include "../src/grid.h"
 #include "../src/particles.h"
 #include "../src/util.h"
+#include "../src/parallel.h"
 
 bool printPassed = false;
 
@@ -87,6 +90,72 @@ int main(int argc, char *argv[]) {
     
     f->reconstructSurface(p, 1.0f, 0.6f);
     f->reinitialize(2);
+
+    // Narrow band fast marching against sweeping until converged
+    FluidSDF::Ptr swept = FluidSDF::create(fluidSettings);
+    swept->reconstructSurface(p, 1.0f, 0.6f);
+    swept->reinitialize(20);
+    fluidSettings->useNarrowBand = true;
+    fluidSettings->narrowBandWidth = 6.0f;
+    FluidSDF::Ptr band = FluidSDF::create(fluidSettings);
+    band->reconstructSurface(p, 1.0f, 0.6f);
+    band->reinitialize(0);
+    float bandError = 0;
+    bool clamped = true;
+    for (int i = 0; i < res; ++i) {
+        for (int j = 0; j < res; ++j) {
+            if (swept->phi(i,j) < 5.0f) {
+                bandError = max(bandError,
+                                std::fabs(band->phi(i,j) - swept->phi(i,j)));
+            } else if (swept->phi(i,j) >= 6.0f) {
+                clamped = clamped && band->phi(i,j) == 6.0f;
+            }
+        }
+    }
+    numFailed += test(bandError < 1e-4, "narrow band distances");
+    numFailed += test(clamped, "narrow band clamping");
+    const float d = band->phi(mid.x + radius + 3, mid.y);
+    numFailed += test(d > 2.5 && d < 4.5, "narrow band distance");
+
+    // The wavefront sweeps give the serial result for any number of threads
+    fluidSettings->useNarrowBand = false;
+    FluidSDF::Ptr serial = FluidSDF::create(fluidSettings);
+    FluidSDF::Ptr parallel = FluidSDF::create(fluidSettings);
+    setNumThreads(1);
+    serial->reconstructSurface(p, 1.0f, 0.6f);
+    serial->reinitialize(2);
+    setNumThreads(4);
+    parallel->reconstructSurface(p, 1.0f, 0.6f);
+    parallel->reinitialize(2);
+    bool identical = true;
+    for (int i = 0; i < res; ++i) {
+        for (int j = 0; j < res; ++j) {
+            identical = identical && serial->phi(i,j) == parallel->phi(i,j);
+        }
+    }
+    numFailed += test(identical, "parallel sweeps");
+
+    // Band extrapolation carries a uniform velocity out exactly
+    // numExtrapolationLayers faces, and leaves the far field alone
+    Particles::Ptr moving = Particles::create();
+    for (int k = 0; k < p->numParticles(); ++k) {
+        moving->addParticle(p->pos(k), Vec2f(1.0f, -2.0f));
+    }
+    fluidSettings->useBandExtrapolation = true;
+    fluidSettings->numExtrapolationLayers = 4;
+    Grid::Ptr grid = Grid::create(fluidSettings);
+    grid->sampleVelocities(moving);
+    grid->extrapolateVelocities(serial, 0);
+    const int edge = mid.x + radius;
+    numFailed += test(grid->u().face<LEFT>(edge + 3, mid.y) == 1.0f,
+                      "band extrapolation");
+    numFailed += test(grid->v().face<BOTTOM>(mid.x, edge + 3) == -2.0f,
+                      "band extrapolation");
+    numFailed += test(grid->u().face<LEFT>(edge + 10, mid.y) == 0.0f,
+                      "band extrapolation far field");
+    numFailed += test(grid->v().face<BOTTOM>(mid.x, edge + 10) == 0.0f,
+                      "band extrapolation far field");
+
     f->extrapolateIntoSolid(s);
     numFailed += test(f->isFluid(res*0.5,res*0.5), "weights");
     
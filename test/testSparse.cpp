@@ -1,6 +1,9 @@
 #include <iostream>
 
 #include "../src/sparse.h"
+#include "../src/laplace.h"
+#include "../src/simd.h"
+#include "../src/util.h"
 
 bool printPassed = false;
 
@@ -17,6 +20,97 @@ int test(bool cond, const char * msg)
     }
 }
 
+bool equal(const Array2f & a, const Array2f & b)
+{
+    for (int i = 0; i < a.nx(); ++i) {
+        for (int j = 0; j < a.ny(); ++j) {
+            if (a(i,j) != b(i,j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Compares the whole-array kernels to the cell by cell ones
+int testLaplace(SimdLevel level, const char * name)
+{
+    setMaxSimdLevel(level);
+
+    // The interior of a column isn't a multiple of the vector width
+    const int nx = 19;
+    const int ny = 45;
+    SparseLaplacianMatrix<float> A(nx,ny);
+    Array2f x(nx,ny,1.0), b(nx,ny,1.0), mask(nx,ny,1.0);
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            // Some fluid cells with a zero diagonal, which relax skips
+            A.value<CENTER>(i,j) = random(0.0, 1.0) < 0.1 ? 0 : random(1.0, 4.0);
+            A.value<RIGHT>(i,j) = random(-1.0, 0.0);
+            A.value<TOP>(i,j) = random(-1.0, 0.0);
+            x(i,j) = random(-1.0, 1.0);
+            b(i,j) = random(-1.0, 1.0);
+            mask(i,j) = random(-1.0, 0.5);
+        }
+    }
+
+    Array2f y(nx,ny,1.0), yRef(nx,ny,1.0), r(nx,ny,1.0), rRef(nx,ny,1.0);
+    float dotRef = 0;
+    for (int i = 0; i < nx; ++i) {
+        float sum = 0;
+        for (int j = 0; j < ny; ++j) {
+            yRef(i,j) = mask(i,j) < 0 ? A.mult(x,i,j) : 0;
+            rRef(i,j) = mask(i,j) < 0 ? b(i,j) - A.mult(x,i,j) : 0;
+            sum += x(i,j) * yRef(i,j);
+        }
+        dotRef += sum;
+    }
+
+    int numFailed = 0;
+    std::vector<float> columnSums;
+    y.set(2.0);
+    multLaplace(A, x, mask, y);
+    numFailed += test(equal(y, yRef), name);
+    y.set(2.0);
+    const float dot = multLaplaceDot(A, x, mask, y, columnSums);
+    numFailed += test(equal(y, yRef) && dot == dotRef, name);
+    r.set(2.0);
+    residualLaplace(A, x, b, mask, r);
+    numFailed += test(equal(r, rRef), name);
+
+    // Jacobi
+    Array2f p(nx,ny,1.0), pRef(nx,ny,1.0);
+    p.copy(x);
+    pRef.copy(x);
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            if (mask(i,j) < 0 && A.value<CENTER>(i,j)) {
+                pRef(i,j) = (b(i,j) - A.multNeighbors(x,i,j)) /
+                        A.value<CENTER>(i,j);
+            }
+        }
+    }
+    relaxLaplace(A, b, mask, x, p, -1);
+    numFailed += test(equal(p, pRef), name);
+
+    // Red-black Gauss-Seidel, red then black
+    p.copy(x);
+    pRef.copy(x);
+    for (int parity = 0; parity < 2; ++parity) {
+        for (int i = 0; i < nx; ++i) {
+            for (int j = (parity + i) % 2; j < ny; j += 2) {
+                if (mask(i,j) < 0 && A.value<CENTER>(i,j)) {
+                    pRef(i,j) = (b(i,j) - A.multNeighbors(pRef,i,j)) /
+                            A.value<CENTER>(i,j);
+                }
+            }
+        }
+        relaxLaplace(A, b, mask, p, p, parity);
+        numFailed += test(equal(p, pRef), name);
+    }
+    return numFailed;
+}
+
 int main(int argc, char *argv[]) {
     std::cout << "Starting sparse matrix test..." << std::endl;
 
@@ -40,4 +134,12 @@ int main(int argc, char *argv[]) {
 
     numFailed += test(A.mult(x,0,0) == 6.0, "mult");
     numFailed += test(A.mult(x,1,1) == 11.0, "mult");
+
+    const char * names[] = { "laplace scalar", "laplace avx2",
+                             "laplace avx512" };
+    for (int level = SIMD_SCALAR; level <= SIMD_AVX512; ++level) {
+        numFailed += testLaplace(static_cast<SimdLevel>(level), names[level]);
+    }
+
+    std::cout << "Number of failed tests: " << numFailed << std::endl;
 }